@@ -87,6 +87,56 @@ void setup() {
 
     server.begin();
 
+    // маршруты
+    server.on("/", [](ghttp::ServerBase::Request req) {
+        // большие текстовые PROGMEM "файлы" эффективнее отсылать через sendFile
+        // отправка идёт сильно бысрее, чем отправка в send как текст
+        server.sendFile_P(html_p, "text/html");
+
+        // server.sendFile((uint8_t*)"hello text!", 11);
+        // File f = LittleFS.open("lorem.txt", "r");
+        // server.sendFile(f);
+    });
+
+    server.on("/answer", [](ghttp::ServerBase::Request req) {
+        // chunked
+        server.send("hello");
+        server.send(", ");
+        server.send("WORLD");
+
+        // single
+        // server.sendSingle("HELLO, WORLD");
+    });
+
+    server.on("/answer_headers", [](ghttp::ServerBase::Request req) {
+        // добавить свои хэдеры к send
+        ghttp::ServerBase::Headers headers(200);
+        headers.add("kek-header", "kek value");
+        headers.add("another-header", "jello!");
+        server.beginResponse(headers);
+
+        server.send("this is ");
+        server.send("answer");
+    });
+
+    server.on("/file_headers", [](ghttp::ServerBase::Request req) {
+        // добавить свои хэдеры к файлу
+        ghttp::ServerBase::Headers headers(200);
+        headers.add("file-header", "abcdef");
+        server.beginResponse(headers);
+
+        char file[] = "hello!";
+        server.sendFile((uint8_t*)file, strlen(file));
+    });
+
+    // параметр пути: /led/3/on
+    server.on("POST", "/led/:id/:state", [](ghttp::ServerBase::Request req) {
+        Serial.println(req.pathArg("id"));
+        Serial.println(req.pathArg("state"));
+        server.send(200);
+    });
+
+    // все запросы, не совпавшие с маршрутами
     server.onRequest([](ghttp::ServerBase::Request req) {
         // URL
         Serial.println(req.method());
@@ -101,43 +151,7 @@ void setup() {
         // req.body().writeTo(file);
         // req.body().stream.readBytes(buf, req.length());
 
-        // RESPONSE
-        if (req.url() == "/") {
-            // большие текстовые PROGMEM "файлы" эффективнее отсылать через sendFile
-            // отправка идёт сильно бысрее, чем отправка в send как текст
-            server.sendFile_P(html_p, "text/html");
-
-            // server.sendFile((uint8_t*)"hello text!", 11);
-            // File f = LittleFS.open("lorem.txt", "r");
-            // server.sendFile(f);
-        } else if (req.url() == "/answer") {
-            // chunked
-            server.send("hello");
-            server.send(", ");
-            server.send("WORLD");
-
-            // single
-            // server.sendSingle("HELLO, WORLD");
-        } else if (req.url() == "/answer_headers") {
-            // добавить свои хэдеры к send
-            ghttp::ServerBase::Headers headers(200);
-            headers.add("kek-header", "kek value");
-            headers.add("another-header", "jello!");
-            server.beginResponse(headers);
-
-            server.send("this is ");
-            server.send("answer");
-        } else if (req.url() == "/file_headers") {
-            // добавить свои хэдеры к файлу
-            ghttp::ServerBase::Headers headers(200);
-            headers.add("file-header", "abcdef");
-            server.beginResponse(headers);
-
-            char file[] = "hello!";
-            server.sendFile((uint8_t*)file, strlen(file));
-        } else {
-            server.send(200);
-        }
+        server.send(200);
     });
 }
 
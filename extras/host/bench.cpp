@@ -0,0 +1,430 @@
+// Замеры производительности GyverHTTP на ПК: разбор хэдеров, чтение тела, отправка файлов, gzip и keep-alive нагрузка.
+// Все данные идут через память (Loopback и буферы), без сети. Результат - JSON, одна строка на замер:
+//   make STRINGUTILS=путь/к/StringUtils/src bench > bench.jsonl
+//   ./build/bench [фильтр]   - только замеры, в имени которых есть фильтр
+
+// блок пула больше наибольшего замеряемого, иначе размер блока ограничен пулом (512 по умолчанию)
+#define GHTTP_POOL_BLOCK_SIZE 4096
+
+#include <Arduino.h>
+#include <FS.h>
+#include <Loopback.h>
+#include <GyverHTTP.h>
+
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifndef GHTTP_BENCH_VERSION
+#define GHTTP_BENCH_VERSION ""
+#endif
+
+// ================== ALLOCATIONS ==================
+// счётчик выделений памяти через new. Блоки пула и String идут через new/realloc шима, malloc не учитывается
+static size_t allocs = 0;
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"  // new и delete заменены парой malloc/free
+#endif
+
+void* operator new(size_t size) {
+    allocs++;
+    void* p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+void operator delete(void* p) noexcept {
+    free(p);
+}
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+// ================== MEASURE ==================
+static const char* filter = nullptr;
+
+// замер выбран фильтром командной строки
+static bool enabled(const char* name) {
+    return !filter || strstr(name, filter);
+}
+
+// замер: время каждой операции, байты и выделения памяти за всё время
+class Bench {
+   public:
+    Bench(const char* name, const std::string& param, size_t ops) : _name(name), _param(param) {
+        _ns.reserve(ops);
+    }
+
+    void begin() {
+        _allocs = allocs;
+        _t0 = _now();
+    }
+    // конец операции. n - операций за замер (очередь запросов), время делится поровну
+    void end(size_t bytes, bool ok = true, size_t n = 1) {
+        uint64_t t = _now();
+        for (size_t i = 0; i < n; i++) _ns.push_back((t - _t0) / n);
+        _bytes += bytes;
+        _newAllocs += allocs - _allocs;
+        if (!ok) _fails += n;
+    }
+
+    // вывести строку JSON
+    void report() {
+        if (_ns.empty()) return;
+        uint64_t total = 0;
+        for (uint64_t ns : _ns) total += ns;
+        double sec = total / 1e9;
+        printf("{\"version\":\"%s\",\"bench\":\"%s\",\"param\":\"%s\",\"ops\":%zu,\"ops_s\":%.0f,\"bytes_s\":%.0f,\"p50_us\":%.3f,\"p99_us\":%.3f,\"allocs_op\":%.2f,\"fails\":%zu}\n",
+               GHTTP_BENCH_VERSION, _name, _param.c_str(), _ns.size(),
+               _ns.size() / sec, _bytes / sec,
+               _percentile(50) / 1e3, _percentile(99) / 1e3,
+               (double)_newAllocs / _ns.size(), _fails);
+        fflush(stdout);
+    }
+
+   private:
+    const char* _name;
+    std::string _param;
+    std::vector<uint64_t> _ns;
+    uint64_t _t0 = 0;
+    size_t _allocs = 0;
+    size_t _newAllocs = 0;
+    size_t _bytes = 0;
+    size_t _fails = 0;
+
+    static uint64_t _now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    uint64_t _percentile(uint8_t p) {
+        size_t i = (_ns.size() - 1) * p / 100;
+        std::nth_element(_ns.begin(), _ns.begin() + i, _ns.end());
+        return _ns[i];
+    }
+};
+
+// ================== STREAMS ==================
+// поток чтения из буфера в памяти
+class MemStream : public Stream {
+   public:
+    MemStream(const std::string& data) : _data(data) {}
+
+    void rewind() {
+        _pos = 0;
+    }
+
+    int available() override {
+        return _data.size() - _pos;
+    }
+    int read() override {
+        return available() ? (uint8_t)_data[_pos++] : -1;
+    }
+    int peek() override {
+        return available() ? (uint8_t)_data[_pos] : -1;
+    }
+    size_t readBytes(char* buf, size_t len) override {
+        len = std::min(len, (size_t)available());
+        memcpy(buf, _data.data() + _pos, len);
+        _pos += len;
+        return len;
+    }
+    using Stream::readBytes;
+    size_t write(uint8_t) override {
+        return 0;
+    }
+
+   private:
+    const std::string& _data;
+    size_t _pos = 0;
+};
+
+// приёмник данных: только считает байты
+class NullPrint : public Print {
+   public:
+    size_t write(uint8_t) override {
+        bytes++;
+        return 1;
+    }
+    size_t write(const uint8_t*, size_t len) override {
+        bytes += len;
+        return len;
+    }
+    int availableForWrite() override {
+        return LOOPBACK_WINDOW;
+    }
+
+    size_t bytes = 0;
+};
+
+class CountCollector : public ghttp::HeadersCollector {
+   public:
+    void header(Text& name, Text& value) {
+        count++;
+    }
+    size_t count = 0;
+};
+
+static std::string num(size_t n) {
+    return std::to_string(n);
+}
+
+static std::string requestWith(size_t headers) {
+    std::string req = "GET /api/data?id=42&mode=full HTTP/1.1\r\nHost: 192.168.1.10\r\n";
+    for (size_t i = 0; i < headers; i++) {
+        req += "X-Bench-Header-" + num(i) + ": value-" + num(i) + "-abcdefghijklmnop\r\n";
+    }
+    return req + "Content-Type: text/plain\r\nContent-Length: 0\r\nConnection: keep-alive\r\n\r\n";
+}
+
+static std::string chunkedBody(const std::string& body, size_t chunk) {
+    std::string out;
+    char line[24];
+    for (size_t i = 0; i < body.size(); i += chunk) {
+        size_t len = std::min(chunk, body.size() - i);
+        snprintf(line, sizeof(line), "%zx\r\n", len);
+        out += line;
+        out.append(body, i, len);
+        out += "\r\n";
+    }
+    return out + "0\r\n\r\n";
+}
+
+// ================== BENCHES ==================
+// HeadersParser: стартовая строка и n хэдеров из буфера в памяти
+static void benchHeaders(size_t ops) {
+    for (size_t n : {0, 4, 16, 32}) {
+        Bench b("headers", "n=" + num(n), ops);
+        std::string req = requestWith(n);
+        CountCollector col;
+        for (size_t i = 0; i < ops; i++) {
+            b.begin();
+            char buf[HS_LINE_SIZE];
+            ghttp::HeadersParser parser(buf, sizeof(buf));
+            parser.parse(req.data(), req.size(), &col);
+            b.end(req.size(), parser.valid);
+        }
+        b.report();
+    }
+}
+
+// Params: разбор строки запроса с n параметрами и поиск каждого ключа
+static void benchParams(size_t ops) {
+    for (size_t n : {4, 16}) {
+        Bench b("params", "n=" + num(n), ops);
+        std::string query;
+        for (size_t i = 0; i < n; i++) query += (i ? "&key" : "key") + num(i) + "=value%20" + num(i);
+        std::vector<std::string> keys;
+        for (size_t i = 0; i < n; i++) keys.push_back("key" + num(i));
+        ghttp::Params params;
+        char buf[HS_LINE_SIZE];
+        for (size_t i = 0; i < ops; i++) {
+            memcpy(buf, query.data(), query.size());
+            b.begin();
+            params.begin(Text(buf, query.size()));
+            size_t found = 0;
+            for (const std::string& k : keys) found += params.has(Text(k.c_str(), k.size()));
+            b.end(query.size(), found == n);
+        }
+        b.report();
+    }
+}
+
+// StreamReader::writeTo: тело с Content-Length и chunked при разных размерах блока
+static void benchReader(size_t ops) {
+    std::string body(65536, 'x');
+    for (size_t chunk : {0, 256, 4096}) {
+        std::string data = chunk ? chunkedBody(body, chunk) : body;
+        MemStream stream(data);
+        for (size_t bsize : {128, 512, 2920}) {
+            Bench b("reader", (chunk ? "chunked=" + num(chunk) : std::string("length")) + ",block=" + num(bsize), ops);
+            for (size_t i = 0; i < ops; i++) {
+                stream.rewind();
+                NullPrint sink;
+                b.begin();
+                StreamReader reader(&stream, chunk ? 0 : body.size(), chunk);
+                reader.setAdaptive(false);
+                reader.setBlockSize(bsize);
+                reader.writeTo(sink);
+                b.end(sink.bytes, sink.bytes == body.size());
+            }
+            b.report();
+        }
+    }
+}
+
+// StreamWriter::printTo: файл и PROGMEM при разных размерах блока, 0 - адаптивный
+static void benchWriter(size_t ops, fs::FS& fs) {
+    static uint8_t data[65536];
+    for (bool file : {false, true}) {
+        for (size_t bsize : {128, 512, 1460, 2920, 0}) {
+            Bench b("writer", std::string(file ? "file" : "progmem") + ",block=" + (bsize ? num(bsize) : "adaptive"), ops);
+            for (size_t i = 0; i < ops; i++) {
+                File f = fs.open("/bench.bin", "r");
+                NullPrint sink;
+                b.begin();
+                StreamWriter writer = file ? StreamWriter(&f) : StreamWriter(data, sizeof(data), true);
+                writer.setAdaptive(!bsize);
+                writer.setBlockSize(bsize);
+                writer.printTo(sink);
+                b.end(sink.bytes, sink.bytes == sizeof(data));
+            }
+            b.report();
+        }
+    }
+}
+
+// приёмник данных в строку
+class StringPrint : public Print {
+   public:
+    size_t write(uint8_t c) override {
+        s += (char)c;
+        return 1;
+    }
+    size_t write(const uint8_t* data, size_t len) override {
+        s.append((const char*)data, len);
+        return len;
+    }
+
+    std::string s;
+};
+
+// GzipWriter и распаковка тела ответа в StreamReader: JSON 64 кБ. bytes_s - по несжатым данным
+static void benchGzip(size_t ops) {
+    std::string json;
+    for (size_t i = 0; json.size() < 65536; i++) json += "{\"t\":" + num(1700000000 + i * 10) + ",\"temp\":" + num(20 + i % 7) + ",\"hum\":" + num(40 + i % 13) + "},";
+
+    static ghttp::GzipWriter writer;
+    StringPrint gz;
+    {
+        Bench b("gzip", "compress", ops);
+        for (size_t i = 0; i < ops; i++) {
+            gz.s.clear();
+            b.begin();
+            writer.begin(&gz);
+            writer.write((const uint8_t*)json.data(), json.size());
+            writer.end();
+            b.end(json.size());
+        }
+        b.report();
+    }
+
+    static ghttp::GzipReader reader;
+    MemStream stream(gz.s);
+    {
+        Bench b("gzip", "decompress,ratio=" + num(json.size() * 100 / gz.s.size()), ops);
+        for (size_t i = 0; i < ops; i++) {
+            stream.rewind();
+            NullPrint sink;
+            b.begin();
+            StreamReader body(&stream, gz.s.size());
+            body.setGzip(&reader);
+            body.writeTo(sink);
+            b.end(sink.bytes, sink.bytes == json.size());
+        }
+        b.report();
+    }
+}
+
+// keep-alive нагрузка: сервер и асинхронный клиент в одном потоке, запросы по одному подключению.
+// Время запроса - от постановки в очередь до конца ответа, выделения памяти - клиента и сервера вместе
+static void benchKeepAlive(size_t ops) {
+    static uint8_t file[16384];
+    static const char page[] PROGMEM = "<h1>GyverHTTP bench</h1>";
+
+    ghttp::Server<LoopbackServer, LoopbackClient> server(80);
+    server.begin();
+    server.onRequest([&server](ghttp::ServerBase::Request req) {
+        if (req.path() == "/small") server.sendFile_P((const uint8_t*)page, strlen_P(page), "text/html");
+        else if (req.path() == "/file") server.sendFile_P(file, sizeof(file), "application/octet-stream");
+        else if (req.path() == "/echo") server.send(req.body().readString());
+        else server.send(404);
+    });
+
+    struct Case {
+        const char* param;
+        const char* path;
+        const char* method;
+        size_t headers;
+        size_t payload;
+        size_t pipeline;
+    };
+    const Case cases[] = {
+        {"GET /small", "/small", "GET", 0, 0, 1},
+        {"GET /small,headers=16", "/small", "GET", 16, 0, 1},
+        {"GET /file", "/file", "GET", 0, 0, 1},
+        {"POST /echo", "/echo", "POST", 0, 1024, 1},
+        {"GET /small,pipeline", "/small", "GET", 0, 0, HC_QUEUE_SIZE},
+    };
+
+    for (const Case& c : cases) {
+        Bench b("keepalive", c.param, ops);
+
+        std::string headers;
+        for (size_t i = 0; i < c.headers; i++) headers += "X-Bench-Header-" + num(i) + ": value-" + num(i) + "\r\n";
+        std::string payload(c.payload, 'p');
+
+        LoopbackClient socket;
+        ghttp::Client http(socket, "127.0.0.1", 80);
+        http.setAsync(true);
+
+        size_t done = 0, bytes = 0, fails = 0;
+        auto cb = [&](ghttp::Client::Response& resp, const uint8_t* data, size_t len) {
+            if (!resp.final()) return;
+            if (resp.code() != 200 || resp.error() != ghttp::Client::Error::None) fails++;
+            bytes += resp.index();
+            done++;
+        };
+
+        // прогрев: подключение и буферы
+        http.request(cb, c.path, c.method, Text(headers.data(), headers.size()), Text(payload.data(), payload.size()));
+        while (done < 1) {
+            server.tick();
+            http.tick();
+        }
+
+        for (size_t i = 0; i < ops; i += c.pipeline) {
+            size_t n = std::min(c.pipeline, ops - i);
+            done = bytes = fails = 0;
+            b.begin();
+            for (size_t k = 0; k < n; k++) {
+                http.request(cb, c.path, c.method, Text(headers.data(), headers.size()), Text(payload.data(), payload.size()));
+            }
+            while (done < n && (http.busy() || http.queued())) {
+                server.tick();
+                http.tick();
+            }
+            b.end(bytes, !fails && done == n, n);
+        }
+        b.report();
+        http.stop();
+        server.tick();
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) filter = argv[1];
+
+    static uint8_t data[65536];
+    for (size_t i = 0; i < sizeof(data); i++) data[i] = i;
+    fs::FS memfs;
+    memfs.add("/bench.bin", data, sizeof(data));
+
+    if (enabled("headers")) benchHeaders(100000);
+    if (enabled("params")) benchParams(100000);
+    if (enabled("reader")) benchReader(2000);
+    if (enabled("writer")) benchWriter(2000, memfs);
+    if (enabled("gzip")) benchGzip(500);
+    if (enabled("keepalive")) benchKeepAlive(20000);
+    return 0;
+}
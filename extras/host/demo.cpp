@@ -0,0 +1,503 @@
+// GyverHTTP на ПК: сервер и асинхронный клиент в одном процессе, через память и через TCP сокеты.
+// Сборка: make STRINGUTILS=путь/к/StringUtils/src && ./build/demo
+
+#define GHTTP_METRICS
+
+#include <Arduino.h>
+#include <FS.h>
+#include <HostSocket.h>
+#include <Loopback.h>
+#include <GyverHTTP.h>
+
+#include <string>
+
+static const char page[] PROGMEM = "<h1>GyverHTTP host</h1>";
+static fs::FS memfs;
+static int fails = 0;
+static const size_t ANY_LENGTH = (size_t)-1;
+
+// поток, который через раз сообщает, что данных нет, и отдаёт их по 3 байта
+class SlowStream : public Stream {
+   public:
+    SlowStream(const char* str) : _str(str) {}
+
+    int available() override {
+        _ready = !_ready;
+        return _ready ? std::min(strlen(_str + _pos), (size_t)3) : 0;
+    }
+    int read() override {
+        return _str[_pos] ? _str[_pos++] : -1;
+    }
+    int peek() override {
+        return _str[_pos] ? _str[_pos] : -1;
+    }
+    size_t write(uint8_t) override {
+        return 0;
+    }
+
+   private:
+    const char* _str;
+    size_t _pos = 0;
+    bool _ready = true;
+};
+
+template <typename server_t, typename client_t>
+class Demo {
+   public:
+    Demo(uint16_t port) : port(port), server(port), http(socket, "127.0.0.1", port) {}
+
+    void run(const char* name) {
+        printf("== %s\n", name);
+        server.begin();
+        _routes();
+        server.onRequest([this](ghttp::ServerBase::Request req) {
+            if (req.path() == "/") server.sendFile_P((const uint8_t*)page, strlen_P(page), "text/html");
+            else if (req.path() == "/echo") server.send(req.body().readString());
+            else if (req.path() == "/length") server.send(String(req.body().length()));
+            else if (req.path() == "/params") {
+                // параметры декодируются без изменения урла
+                String url = req.url().toString();
+                bool ok = req.param("q") == "a b" && req.param("z") == "1" && !req.param("id").valid() && req.url() == Text(url);
+                server.send(ok ? 200 : 500);
+            }
+            else if (req.path() == "/file") {
+                File file = memfs.open("/data.bin", "r");
+                server.sendFile(file);
+            } else server.send(404);
+        });
+
+        http.setAsync(true);
+        _check("GET /", "/", "GET", Text(), strlen_P(page));
+        _check("POST /echo", "/echo", "POST", "hello host", 10);
+        _check("GET /file", "/file", "GET", Text(), 100000);
+        _check("GET /params", "/params?q=a%20b&z=1&uid=5", "GET", Text(), 0);
+        _check("GET /none", "/none", "GET", Text(), 0, 404);
+        http.stop();
+        _formData();
+        _upload();
+        _events();
+        _webSocket();
+
+        // конец тела ответа по хэдерам или по закрытию подключения, повторное использование подключения
+        _framing("http/1.0", "HTTP/1.0 200 OK\r\n\r\nabc", "abc", true, false);
+        _framing("no length", "HTTP/1.1 200 OK\r\n\r\nabc", "abc", true, false);
+        _framing("empty close", "HTTP/1.1 200 OK\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", "", false, false);
+        _framing("1.0 keep", "HTTP/1.0 200 OK\r\nConnection: keep-alive\r\nContent-Length: 3\r\n\r\nabc", "abc", false, true);
+        _pipeline();
+        _retry();
+        _pool();
+
+        // разбор хэдеров: ошибки и чтение без захвата следующего запроса
+        _raw("pipelined", "GET /none HTTP/1.1\r\n\r\nGET /none HTTP/1.1\r\n\r\n", "HTTP/1.1 404", 2);
+        _raw("long header", "GET / HTTP/1.1\r\nX: " + std::string(600, 'a') + "\r\n\r\n", "HTTP/1.1 431");
+        _raw("bad length", "POST /echo HTTP/1.1\r\nContent-Length: 5x\r\n\r\nhello", "HTTP/1.1 400");
+        // имя с тем же хэшем, что и content-length
+        _raw("route args", "POST /led/7/on HTTP/1.1\r\n\r\n", "\r\n7=on\r\n");
+        _raw("route method", "GET /led/7/on HTTP/1.1\r\n\r\n", "HTTP/1.1 404");
+        _raw("route tail", "GET /files/a/b.txt HTTP/1.1\r\n\r\n", "\r\na/b.txt\r\n");
+        _raw("multipart", _multipart("/upload", "--XyZ\r\nContent-Disposition: form-data; name=\"f\"; filename=\"a;b.txt\"\r\nContent-Type: text/plain\r\n\r\nhello\r\n"
+                                            "--XyZ\r\nContent-Disposition: form-data; name=\"n\"\r\n\r\n42\r\n--XyZ--\r\n"),
+             "f:a;b.txt:hello|n::42|");
+        // body() - первая часть, как до разбора по частям
+        _raw("first part", _multipart("/first", "--XyZ\r\nContent-Disposition: form-data; name=\"f\"\r\n\r\nhello\r\n--XyZ--\r\n"), "Connection: close\r\n\r\nhello");
+        _raw("hash clash", "POST /length HTTP/1.1\r\nContent-Lengv&: 5\r\n\r\n", "\r\n\r\n0");
+    }
+
+    // сервер без обработчиков, только статичные файлы
+    void runStatic(const char* name) {
+        printf("== %s\n", name);
+        server.begin();
+        server.serveStatic("/", memfs);
+
+        http.setAsync(true);
+        _check("GET static", "/data.bin", "GET", Text(), 100000);
+        _check("GET missing", "/none.bin", "GET", Text(), 0, 404);
+        http.stop();
+
+        // ETag из ответа, повторный запрос с ним - 304 без тела
+        std::string head = _raw("HEAD etag", "HEAD /data.bin HTTP/1.1\r\n\r\n", "\r\n\r\n");
+        size_t from = head.find("ETag: ");
+        std::string etag = (from == std::string::npos) ? "\"\"" : head.substr(from + 6, head.find("\r\n", from) - from - 6);
+        _raw("GET 304", "GET /data.bin HTTP/1.1\r\nIf-None-Match: " + etag + "\r\n\r\n", "HTTP/1.1 304");
+        _raw("GET etag", "GET /data.bin HTTP/1.1\r\nIf-None-Match: \"x\", " + etag + "\r\n\r\n", "HTTP/1.1 304");
+        _raw("GET changed", "GET /data.bin HTTP/1.1\r\nIf-None-Match: \"x\"\r\n\r\n", "HTTP/1.1 200");
+
+        // диапазоны: начало, последние байты, за пределами файла
+        std::string part = _raw("GET range", "GET /data.bin HTTP/1.1\r\nRange: bytes=10-13\r\n\r\n", "\r\n\r\n\x0a\x0b\x0c\x0d");
+        _result("range head", part.find("HTTP/1.1 206") == 0 && part.find("Content-Range: bytes 10-13/100000\r\n") != std::string::npos);
+        _raw("GET suffix", "GET /data.bin HTTP/1.1\r\nRange: bytes=-2\r\n\r\n", "Content-Range: bytes 99998-99999/100000\r\n");
+        part = _raw("GET 416", "GET /data.bin HTTP/1.1\r\nRange: bytes=100000-\r\n\r\n", "\r\n\r\n");
+        _result("416 head", part.find("HTTP/1.1 416") == 0 && part.find("Content-Range: bytes */100000\r\n") != std::string::npos);
+    }
+
+    // сервер без обработчиков, только метрики
+    void runMetrics(const char* name) {
+        printf("== %s\n", name);
+        server.begin();
+        server.serveMetrics();
+
+        http.setAsync(true);
+        _check("GET metrics", "/metrics", "GET", Text(), ANY_LENGTH);
+        _check("GET other", "/other", "GET", Text(), 0, 404);
+        http.stop();
+    }
+
+   private:
+    uint16_t port;
+    ghttp::Server<server_t, client_t> server;
+    client_t socket;
+    ghttp::Client http;
+
+    void _check(const char* title, const char* path, const char* method, const Text& payload, size_t len, uint16_t code = 200) {
+        bool done = false;
+        bool ok = false;
+        http.onBody([&](ghttp::Client::Response& resp, const uint8_t* data, size_t n) {
+            if (!resp.final()) return;
+            ok = resp.code() == code && (len == ANY_LENGTH ? resp.index() > 0 : resp.index() == len) && resp.error() == ghttp::Client::Error::None;
+            done = true;
+        });
+        uint32_t us = micros();
+        http.request(path, method, Text(), payload);
+        while (!done) {
+            server.tick();
+            http.tick();
+        }
+        us = micros() - us;
+        printf("%-12s %s %u us\n", title, ok ? "OK" : "FAIL", (unsigned)us);
+        if (!ok) fails++;
+    }
+
+    // маршруты on(): параметры, "*" в конце. Ошибочные маршруты не добавляются
+    void _routes() {
+        server.on("POST", "/led/:id/:state", [this](ghttp::ServerBase::Request req) {
+            server.send(req.pathArg("id").toString() + '=' + req.pathArg("state").toString());
+        });
+        server.on("/files/*", [this](ghttp::ServerBase::Request req) {
+            server.send(req.pathTail().toString());
+        });
+        server.on("/events", [this](ghttp::ServerBase::Request) {
+            server.beginEvents(3000);
+        });
+        server.on("/ws", [this](ghttp::ServerBase::Request) {
+            server.beginWebSocket();
+        });
+        server.onWebSocket([](ghttp::WebSocket& ws, uint8_t* data, size_t len) {
+            if (ws.event() == ghttp::WebSocket::Event::Message) ws.send(data, len, ws.binary());  // эхо
+        });
+        // части multipart: "имя:файл:данные|"
+        server.on("POST", "/upload", [this](ghttp::ServerBase::Request req) {
+            String out;
+            bool ok = req.multipart([&out](ghttp::Multipart::Part& part, const uint8_t* data, size_t len) {
+                if (!part.index) out += part.name.toString() + ':' + part.filename.toString() + ':';
+                out.concat((const char*)data, len);
+                if (part.final) out += '|';
+            });
+            server.send(ok ? out : String("error"));
+        });
+        server.on("POST", "/first", [this](ghttp::ServerBase::Request req) {
+            server.send(req.body().readString());
+        });
+        bool ok = !server.on("/a/*/b", [](ghttp::ServerBase::Request) {}) && !server.on("/:a/1/2/3/4/5/6/7/8", [](ghttp::ServerBase::Request) {});
+        _result("route add", ok);
+    }
+
+    void _result(const char* title, bool ok) {
+        printf("%-12s %s\n", title, ok ? "OK" : "FAIL");
+        if (!ok) fails++;
+    }
+
+    // сервер отвечает response как есть и закрывает подключение при close. reuse - клиент сохранил подключение
+    void _framing(const char* title, const char* response, const char* body, bool close, bool reuse) {
+        server_t raw(port + 100);
+        raw.begin();
+        client_t sock;
+        ghttp::Client client(sock, "127.0.0.1", port + 100);
+        client.setAsync(true);
+        std::string got;
+        bool done = false, ok = false;
+        client.onBody([&](ghttp::Client::Response& resp, const uint8_t* data, size_t n) {
+            got.append((const char*)data, n);
+            if (!resp.final()) return;
+            ok = resp.error() == ghttp::Client::Error::None;
+            done = true;
+        });
+        client.request("/");
+
+        client_t peer;
+        uint32_t ms = millis();
+        while (!done && millis() - ms < 1000) {
+            client.tick();
+            if (peer) continue;
+            peer = raw.accept();
+            if (!peer) continue;
+            peer.write((const uint8_t*)response, strlen(response));
+            if (close) peer.stop();
+        }
+        _result(title, ok && got == body && (bool)sock.connected() == reuse);
+        client.stop();
+    }
+
+    // после ответа keep-alive следующие запросы отправляются конвейером: сервер отвечает, только получив оба
+    void _pipeline() {
+        server_t raw(port + 100);
+        raw.begin();
+        client_t sock;
+        ghttp::Client client(sock, "127.0.0.1", port + 100);
+        client.setAsync(true);
+        std::string got;
+        client.onBody([&](ghttp::Client::Response& resp, const uint8_t* data, size_t n) {
+            got.append((const char*)data, n);
+        });
+        client.request("/1");
+        client.request("/2");
+        client.request("/3");
+
+        client_t peer;
+        std::string in;
+        uint32_t ms = millis();
+        while (got.size() < 3 && millis() - ms < 1000) {
+            client.tick();
+            if (!peer) peer = raw.accept();
+            if (!_readAll(peer, in)) continue;
+            if (in.find("GET /1 ") != std::string::npos) {
+                _respond(peer, "1");
+                in.clear();
+            }
+            if (in.find("GET /2 ") != std::string::npos && in.find("GET /3 ") != std::string::npos) {
+                _respond(peer, "2");
+                _respond(peer, "3");
+                in.clear();
+            }
+        }
+        _result("pipeline", got == "123" && !raw.accept());
+        client.stop();
+    }
+
+    // сервер закрывает keep-alive подключение, пока клиент отправляет следующий запрос - запрос отправляется заново
+    void _retry() {
+        server_t raw(port + 100);
+        raw.begin();
+        client_t sock;
+        ghttp::Client client(sock, "127.0.0.1", port + 100);
+        client.setAsync(true);
+        std::string got, payload(20000, 'x');
+        bool ok = false;
+        client.onBody([&](ghttp::Client::Response& resp, const uint8_t* data, size_t n) {
+            got.append((const char*)data, n);
+            if (resp.final()) ok = resp.error() == ghttp::Client::Error::None;
+        });
+        client.request("/1");
+        client.request("/2", "POST", Text(), (const uint8_t*)payload.data(), payload.size());
+
+        client_t peer;
+        std::string in;
+        uint8_t conns = 0;
+        uint32_t ms = millis();
+        while (got.size() < 2 && millis() - ms < 1000) {
+            client.tick();
+            if (!peer && (peer = raw.accept())) conns++;
+            if (!_readAll(peer, in)) continue;
+            if (conns == 1 && in.find("GET /1 ") != std::string::npos) {
+                _respond(peer, "1");
+                in.clear();
+            } else if (conns == 1 && in.find("POST /2 ") != std::string::npos) {
+                peer.stop();  // начало запроса получено, подключение обрывается
+                peer = client_t();
+                in.clear();
+            } else if (conns == 2 && in.size() >= payload.size() && in.compare(in.size() - payload.size(), payload.size(), payload) == 0) {
+                _respond(peer, "2");
+                in.clear();
+            }
+        }
+        _result("retry", ok && got == "12" && conns == 2);
+        client.stop();
+    }
+
+    // два подписчика Server-Sent Events получают одно событие
+    void _events() {
+        client_t subs[2];
+        std::string resp[2];
+        bool ok = true;
+        for (int i = 0; i < 2; i++) {
+            subs[i].connect("127.0.0.1", port);
+            subs[i].print("GET /events HTTP/1.1\r\n\r\n");
+            ok = _await(subs[i], resp[i], "\r\n\r\nretry: 3000\n\n") && ok;
+        }
+        ok = ok && server.eventClients() == 2 && server.sendEvent("a\nb", "state", "7");
+        for (int i = 0; i < 2; i++) {
+            ok = _await(subs[i], resp[i], "retry: 3000\n\nevent: state\nid: 7\ndata: a\ndata: b\n\n") && ok;
+            subs[i].stop();
+        }
+        for (int i = 0; i < 10; i++) server.tick();
+        _result("events", ok && !server.eventClients());
+    }
+
+    // рукопожатие WebSocket по примеру из RFC 6455, эхо сообщения, ответ на ping и close
+    void _webSocket() {
+        const char* key = "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n";
+        _raw("ws no conn", std::string("GET /ws HTTP/1.1\r\nUpgrade: websocket\r\nSec-WebSocket-Version: 13\r\n") + key + "\r\n", "HTTP/1.1 400");
+        _raw("ws version", std::string("GET /ws HTTP/1.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Version: 8\r\n") + key + "\r\n", "HTTP/1.1 426");
+
+        client_t ws;
+        ws.connect("127.0.0.1", port);
+        ws.print(std::string("GET /ws HTTP/1.1\r\nUpgrade: websocket\r\nConnection: keep-alive, Upgrade\r\nSec-WebSocket-Version: 13\r\n").append(key).append("\r\n").c_str());
+        std::string resp;
+        bool ok = _await(ws, resp, "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n") && resp.find("HTTP/1.1 101") == 0;
+        _result("ws handshake", ok);
+
+        resp.clear();
+        _wsFrame(ws, 0x1, "hi");
+        _wsFrame(ws, 0x9, "p");
+        _wsFrame(ws, 0x8, "\x03\xe8");
+        ok = _await(ws, resp, "\x81\x02hi\x8a\x01p\x88\x02\x03\xe8");
+        for (int i = 0; i < 10; i++) server.tick();
+        _result("ws frames", ok && !ws.connected());
+        ws.stop();
+    }
+
+    // кадр клиента с маской
+    static void _wsFrame(client_t& ws, uint8_t opcode, const std::string& data) {
+        const uint8_t mask[4] = {1, 2, 3, 4};
+        std::string frame;
+        frame += char(0x80 | opcode);
+        frame += char(0x80 | data.size());
+        frame.append((const char*)mask, 4);
+        for (size_t i = 0; i < data.size(); i++) frame += char(data[i] ^ mask[i & 3]);
+        ws.write((const uint8_t*)frame.data(), frame.size());
+    }
+
+    // FormData в блокирующем режиме: часть из потока, который временно пуст, отправляется целиком
+    void _formData() {
+        SlowStream stream("stream data");
+        ghttp::Client::FormData form;
+        form.add("s", "s.txt", "text/plain", stream, strlen("stream data"));
+        form.add("t", "", "", "text");
+
+        http.setAsync(false);
+        bool ok = http.request("/upload", "POST", Text(), form);
+        for (int i = 0; i < 100 && !http.available(); i++) server.tick();
+        ghttp::Client::Response resp = http.getResponse();
+        ok = ok && resp && resp.body().readString() == "s:s.txt:stream data|t::text|";
+        _result("formdata", ok);
+        http.stop();
+    }
+
+    // тело неизвестной длины: печатается в клиента, уходит chunk-ами, сервер возвращает его целиком
+    void _upload() {
+        std::string sent, got;
+        bool done = false, ok = false;
+        http.setAsync(true);
+        http.beginUpload("/echo");
+        for (int i = 0; i < 1000; i++) {
+            std::string line = std::to_string(i * 7919) + ",value\n";
+            http.print(line.c_str());
+            sent += line;
+        }
+        http.endUpload([&](ghttp::Client::Response& resp, const uint8_t* data, size_t n) {
+            got.append((const char*)data, n);
+            if (!resp.final()) return;
+            ok = resp.code() == 200 && resp.error() == ghttp::Client::Error::None;
+            done = true;
+        });
+        uint32_t ms = millis();
+        while (!done && millis() - ms < 1000) {
+            server.tick();
+            http.tick();
+        }
+        _result("chunked up", ok && got == sent);
+        http.stop();
+    }
+
+    // пул на 2 подключения к 3 серверам: повторный запрос идёт по открытому подключению, третий хост вытесняет давно не использованный
+    void _pool() {
+        ghttp::Server<server_t, client_t> a(port + 100), b(port + 101), c(port + 102);
+        ghttp::Server<server_t, client_t>* servers[] = {&a, &b, &c};
+        for (auto* s : servers) {
+            s->begin();
+            s->onRequest([s](ghttp::ServerBase::Request) { s->send("ok"); });
+        }
+        ghttp::ClientPool<client_t, 2> pool;
+        pool.setAsync(true);
+
+        auto get = [&](uint16_t p) {
+            ghttp::Client* http = pool.get("127.0.0.1", p);
+            bool done = false;
+            if (!http || !http->request([&done](ghttp::Client::Response& resp, const uint8_t*, size_t) { done |= resp.final(); }, "/")) return http;
+            uint32_t ms = millis();
+            while (!done && millis() - ms < 1000) {
+                for (auto* s : servers) s->tick();
+                pool.tick();
+            }
+            delay(2);  // время использования слотов различается
+            return done ? http : nullptr;
+        };
+
+        ghttp::Client* ha = get(port + 100);
+        ghttp::Client* hb = get(port + 101);
+        bool ok = ha && hb && ha != hb && get(port + 100) == ha && pool.connected() == 2;
+        ok = ok && get(port + 102) == hb && get(port + 100) == ha;  // b - давно не использованный
+        ok = ok && a.metrics().connections == 1 && b.metrics().connections == 1 && c.metrics().connections == 1;
+        _result("pool lru", ok);
+        pool.stop();
+    }
+
+    // дочитать доступные данные подключения. Вернёт false, если подключения нет
+    static bool _readAll(client_t& peer, std::string& in) {
+        if (!peer) return false;
+        uint8_t buf[512];
+        while (peer.available()) {
+            int n = peer.read(buf, sizeof(buf));
+            if (n <= 0) break;
+            in.append((const char*)buf, n);
+        }
+        return true;
+    }
+
+    static void _respond(client_t& peer, const char* body) {
+        std::string resp = std::string("HTTP/1.1 200 OK\r\nContent-Length: ") + std::to_string(strlen(body)) + "\r\n\r\n" + body;
+        peer.write((const uint8_t*)resp.data(), resp.size());
+    }
+
+    // запрос multipart/form-data с границей XyZ
+    static std::string _multipart(const char* path, const std::string& body) {
+        return std::string("POST ") + path + " HTTP/1.1\r\nContent-Type: multipart/form-data; boundary=XyZ\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+    }
+
+    // отправить запрос как есть и дождаться count вхождений expect в ответе. Вернёт полученную часть ответа
+    std::string _raw(const char* title, const std::string& request, const char* expect, int count = 1) {
+        client_t client;
+        client.connect("127.0.0.1", port);
+        client.write((const uint8_t*)request.data(), request.size());
+        std::string resp;
+        bool ok = _await(client, resp, expect, count);
+        client.stop();
+        server.tick();
+        _result(title, ok);
+        return resp;
+    }
+
+    // тикать сервер и дописывать ответ в resp, пока в нём не будет count вхождений expect
+    bool _await(client_t& client, std::string& resp, const std::string& expect, int count = 1) {
+        int found = 0;
+        uint32_t ms = millis();
+        while (found < count && millis() - ms < 1000) {
+            server.tick();
+            _readAll(client, resp);
+            found = 0;
+            for (size_t i = resp.find(expect); i != std::string::npos; i = resp.find(expect, i + 1)) found++;
+        }
+        return found == count;
+    }
+};
+
+int main() {
+    static uint8_t data[100000];
+    for (size_t i = 0; i < sizeof(data); i++) data[i] = i;
+    memfs.add("/data.bin", data, sizeof(data));
+
+    Demo<LoopbackServer, LoopbackClient>(80).run("loopback");
+    Demo<HostServer, HostClient>(18080).run("tcp 127.0.0.1:18080");
+    Demo<LoopbackServer, LoopbackClient>(81).runStatic("loopback static");
+    Demo<LoopbackServer, LoopbackClient>(82).runMetrics("loopback metrics");
+    return fails ? 1 : 0;
+}
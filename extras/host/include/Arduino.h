@@ -0,0 +1,101 @@
+#pragma once
+// минимальная замена Arduino.h для сборки и замеров GyverHTTP на ПК (Linux/POSIX)
+
+#include <ctype.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using std::max;
+using std::min;
+
+// ================= PROGMEM =================
+// на ПК PROGMEM - обычная память
+#define PROGMEM
+#define PGM_P const char*
+#define PGM_VOID_P const void*
+#define PSTR(s) (s)
+#define FPSTR(p) (reinterpret_cast<const __FlashStringHelper*>(p))
+#define F(s) FPSTR(PSTR(s))
+
+class __FlashStringHelper;
+
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t*)(addr))
+#define pgm_read_float(addr) (*(const float*)(addr))
+#define pgm_read_ptr(addr) (*(const void* const*)(addr))
+
+inline size_t strlen_P(PGM_P s) { return strlen(s); }
+inline void* memcpy_P(void* dest, PGM_VOID_P src, size_t n) { return memcpy(dest, src, n); }
+inline int memcmp_P(const void* a, PGM_VOID_P b, size_t n) { return memcmp(a, b, n); }
+inline char* strcpy_P(char* dest, PGM_P src) { return strcpy(dest, src); }
+inline char* strncpy_P(char* dest, PGM_P src, size_t n) { return strncpy(dest, src, n); }
+inline int strcmp_P(const char* a, PGM_P b) { return strcmp(a, b); }
+inline int strncmp_P(const char* a, PGM_P b, size_t n) { return strncmp(a, b, n); }
+inline int strcasecmp_P(const char* a, PGM_P b) { return strcasecmp(a, b); }
+inline int strncasecmp_P(const char* a, PGM_P b, size_t n) { return strncasecmp(a, b, n); }
+inline const char* strstr_P(const char* a, PGM_P b) { return strstr(a, b); }
+inline const char* strchr_P(PGM_P s, int c) { return strchr(s, c); }
+
+// ================= TIME =================
+inline uint32_t micros() {
+    using namespace std::chrono;
+    static const steady_clock::time_point start = steady_clock::now();
+    return (uint32_t)duration_cast<microseconds>(steady_clock::now() - start).count();
+}
+inline uint32_t millis() {
+    return micros() / 1000;
+}
+inline void delay(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+inline void delayMicroseconds(uint32_t us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+inline void yield() {}
+
+// ================= CONVERT =================
+inline char* ultoa(unsigned long val, char* buf, int base) {
+    char tmp[8 * sizeof(long) + 1];
+    char* p = tmp + sizeof(tmp) - 1;
+    *p = 0;
+    if (base < 2 || base > 36) base = 10;
+    do {
+        char d = val % base;
+        *--p = d < 10 ? d + '0' : d - 10 + 'a';
+        val /= base;
+    } while (val);
+    return strcpy(buf, p);
+}
+inline char* ltoa(long val, char* buf, int base) {
+    if (val < 0 && base == 10) {
+        buf[0] = '-';
+        ultoa(-(unsigned long)val, buf + 1, base);
+        return buf;
+    }
+    return ultoa((unsigned long)val, buf, base);
+}
+inline char* utoa(unsigned val, char* buf, int base) { return ultoa(val, buf, base); }
+inline char* itoa(int val, char* buf, int base) { return ltoa(val, buf, base); }
+inline char* dtostrf(double val, signed char width, unsigned char prec, char* buf) {
+    sprintf(buf, "%*.*f", width, prec, val);
+    return buf;
+}
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+#include "IPAddress.h"
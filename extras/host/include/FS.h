@@ -0,0 +1,120 @@
+#pragma once
+// файловая система в памяти с интерфейсом fs::FS/File
+
+#define FS_H
+
+#include <time.h>
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "Arduino.h"
+
+namespace fs {
+
+class File : public Stream {
+    typedef std::shared_ptr<std::string> Data;
+
+   public:
+    File() {}
+    File(Data data, const char* path, bool append = false) : _data(data), _path(path), _pos(append ? data->size() : 0) {}
+
+    size_t write(uint8_t b) override {
+        return write(&b, 1);
+    }
+    size_t write(const uint8_t* buf, size_t len) override {
+        if (!_data) return 0;
+        _data->replace(_pos, len, (const char*)buf, len);
+        _pos += len;
+        return len;
+    }
+    int available() override {
+        return _data ? _data->size() - _pos : 0;
+    }
+    int read() override {
+        return available() ? (uint8_t)(*_data)[_pos++] : -1;
+    }
+    int peek() override {
+        return available() ? (uint8_t)(*_data)[_pos] : -1;
+    }
+    size_t readBytes(char* buf, size_t len) override {
+        len = std::min(len, (size_t)available());
+        if (len) memcpy(buf, _data->data() + _pos, len);
+        _pos += len;
+        return len;
+    }
+    using Stream::readBytes;
+
+    bool seek(uint32_t pos) {
+        if (!_data || pos > _data->size()) return false;
+        _pos = pos;
+        return true;
+    }
+    size_t position() const {
+        return _pos;
+    }
+    size_t size() const {
+        return _data ? _data->size() : 0;
+    }
+    const char* path() const {
+        return _path.c_str();
+    }
+    const char* name() const {
+        size_t slash = _path.rfind('/');
+        return _path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+    }
+    bool isDirectory() {
+        return false;
+    }
+    time_t getLastWrite() {
+        return 0;
+    }
+    void close() {
+        _data.reset();
+    }
+    explicit operator bool() const {
+        return (bool)_data;
+    }
+
+   private:
+    Data _data;
+    std::string _path;
+    size_t _pos = 0;
+};
+
+class FS {
+   public:
+    // добавить файл с данными
+    void add(const char* path, const void* data, size_t len) {
+        _files[path] = std::make_shared<std::string>((const char*)data, len);
+    }
+
+    File open(const char* path, const char* mode = "r") {
+        auto it = _files.find(path);
+        if (mode[0] == 'w' || (mode[0] == 'a' && it == _files.end())) {
+            it = _files.insert_or_assign(path, std::make_shared<std::string>()).first;
+        }
+        if (it == _files.end()) return File();
+        return File(it->second, path, mode[0] == 'a');
+    }
+    File open(const String& path, const char* mode = "r") {
+        return open(path.c_str(), mode);
+    }
+    bool exists(const char* path) {
+        return _files.count(path);
+    }
+    bool exists(const String& path) {
+        return exists(path.c_str());
+    }
+    bool remove(const char* path) {
+        return _files.erase(path);
+    }
+
+   private:
+    std::map<std::string, std::shared_ptr<std::string>> _files;
+};
+
+}  // namespace fs
+
+using fs::File;
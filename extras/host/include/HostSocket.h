@@ -0,0 +1,199 @@
+#pragma once
+// ::Client и сервер поверх POSIX сокетов
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <memory>
+
+#include "Client.h"
+
+// TCP клиент. Копии разделяют один сокет, как WiFiClient
+class HostClient : public Client {
+    struct Socket {
+        ~Socket() {
+            if (fd >= 0) ::close(fd);
+        }
+        int fd = -1;
+        bool closed = false;
+    };
+
+   public:
+    HostClient() {}
+    explicit HostClient(int fd) : _s(std::make_shared<Socket>()) {
+        _s->fd = fd;
+        _setup();
+    }
+
+    int connect(IPAddress ip, uint16_t port) override {
+        return connect(ip.toString().c_str(), port);
+    }
+    int connect(const char* host, uint16_t port) override {
+        stop();
+        addrinfo hints = {};
+        addrinfo* res = nullptr;
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        char pstr[8];
+        snprintf(pstr, sizeof(pstr), "%u", port);
+        if (getaddrinfo(host, pstr, &hints, &res) || !res) return 0;
+
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        bool ok = fd >= 0 && !::connect(fd, res->ai_addr, res->ai_addrlen);
+        freeaddrinfo(res);
+        if (!ok) {
+            if (fd >= 0) ::close(fd);
+            return 0;
+        }
+        _s = std::make_shared<Socket>();
+        _s->fd = fd;
+        _setup();
+        return 1;
+    }
+
+    size_t write(uint8_t data) override {
+        return write(&data, 1);
+    }
+    size_t write(const uint8_t* buf, size_t size) override {
+        if (!_s) return 0;
+        size_t sent = 0;
+        while (sent < size) {
+            ssize_t n = ::send(_s->fd, buf + sent, size - sent, MSG_NOSIGNAL);
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                pollfd p = {_s->fd, POLLOUT, 0};
+                ::poll(&p, 1, 100);
+                continue;
+            }
+            if (n <= 0) {
+                _s->closed = true;
+                break;
+            }
+            sent += n;
+        }
+        return sent;
+    }
+
+    // свободное место в буфере отправки сокета
+    int availableForWrite() override {
+        if (!_s) return 0;
+        int sndbuf = 0, queued = 0;
+        socklen_t len = sizeof(sndbuf);
+        ::getsockopt(_s->fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, &len);
+        ::ioctl(_s->fd, TIOCOUTQ, &queued);
+        return sndbuf > queued ? sndbuf - queued : 0;
+    }
+
+    int available() override {
+        if (!_s) return 0;
+        int n = 0;
+        ::ioctl(_s->fd, FIONREAD, &n);
+        if (!n) _probe();
+        return n;
+    }
+    int read() override {
+        uint8_t b;
+        return read(&b, 1) == 1 ? b : -1;
+    }
+    int read(uint8_t* buf, size_t size) override {
+        if (!_s) return -1;
+        ssize_t n = ::recv(_s->fd, buf, size, MSG_DONTWAIT);
+        if (!n) _s->closed = true;
+        return n > 0 ? (int)n : -1;
+    }
+    size_t readBytes(char* buf, size_t len) override {
+        size_t got = 0;
+        uint32_t tmr = millis();
+        while (got < len && _s) {
+            int n = read((uint8_t*)buf + got, len - got);
+            if (n > 0) {
+                got += n;
+                tmr = millis();
+                continue;
+            }
+            if (_s->closed || millis() - tmr >= _timeout) break;
+            pollfd p = {_s->fd, POLLIN, 0};
+            ::poll(&p, 1, 1);
+        }
+        return got;
+    }
+    using Stream::readBytes;
+
+    int peek() override {
+        uint8_t b;
+        return (_s && ::recv(_s->fd, &b, 1, MSG_DONTWAIT | MSG_PEEK) == 1) ? b : -1;
+    }
+    void flush() override {}
+    void stop() override {
+        _s.reset();
+    }
+    uint8_t connected() override {
+        if (!_s) return 0;
+        if (!_s->closed) _probe();
+        return !_s->closed || available();
+    }
+    operator bool() override {
+        return (bool)_s;
+    }
+
+    void setNoDelay(bool nodelay) {
+        if (!_s) return;
+        int v = nodelay;
+        ::setsockopt(_s->fd, IPPROTO_TCP, TCP_NODELAY, &v, sizeof(v));
+    }
+
+   private:
+    std::shared_ptr<Socket> _s;
+
+    void _setup() {
+        ::fcntl(_s->fd, F_SETFD, FD_CLOEXEC);
+    }
+    void _probe() {
+        uint8_t b;
+        ssize_t n = ::recv(_s->fd, &b, 1, MSG_DONTWAIT | MSG_PEEK);
+        if (!n || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) _s->closed = true;
+    }
+};
+
+// TCP сервер на 127.0.0.1 (или на всех интерфейсах, any = true)
+class HostServer {
+   public:
+    HostServer(uint16_t port, bool any = false) : _port(port), _any(any) {}
+    ~HostServer() {
+        if (_fd >= 0) ::close(_fd);
+    }
+
+    bool begin() {
+        _fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (_fd < 0) return false;
+        int one = 1;
+        ::setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(_port);
+        addr.sin_addr.s_addr = htonl(_any ? INADDR_ANY : INADDR_LOOPBACK);
+        if (::bind(_fd, (sockaddr*)&addr, sizeof(addr)) || ::listen(_fd, 64)) return false;
+        ::fcntl(_fd, F_SETFL, O_NONBLOCK);
+        return true;
+    }
+
+    HostClient accept() {
+        int fd = _fd >= 0 ? ::accept(_fd, nullptr, nullptr) : -1;
+        return fd >= 0 ? HostClient(fd) : HostClient();
+    }
+    HostClient available() {
+        return accept();
+    }
+
+   private:
+    int _fd = -1;
+    uint16_t _port;
+    bool _any;
+};
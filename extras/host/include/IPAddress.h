@@ -0,0 +1,25 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+#include "WString.h"
+
+class IPAddress {
+   public:
+    IPAddress() {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _ip{a, b, c, d} {}
+
+    uint8_t operator[](int i) const { return _ip[i]; }
+    uint8_t& operator[](int i) { return _ip[i]; }
+    bool operator==(const IPAddress& ip) const { return !memcmp(_ip, ip._ip, 4); }
+    bool operator!=(const IPAddress& ip) const { return !(*this == ip); }
+
+    String toString() const {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%u.%u.%u.%u", _ip[0], _ip[1], _ip[2], _ip[3]);
+        return String(buf);
+    }
+
+   private:
+    uint8_t _ip[4] = {};
+};
@@ -0,0 +1,144 @@
+#pragma once
+// ::Client и сервер в памяти процесса: без сокетов и системных вызовов, для воспроизводимых замеров
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Client.h"
+
+#ifndef LOOPBACK_WINDOW
+#define LOOPBACK_WINDOW 5744    // "буфер отправки" для availableForWrite
+#endif
+
+class LoopbackServer;
+
+// клиент в памяти. Копии разделяют одно подключение, как WiFiClient
+class LoopbackClient : public Client {
+    friend class LoopbackServer;
+
+    // данные одного направления
+    struct Pipe {
+        std::string data;
+        size_t pos = 0;
+        bool closed = false;
+
+        size_t size() const {
+            return data.size() - pos;
+        }
+    };
+
+   public:
+    int connect(IPAddress ip, uint16_t port) override {
+        return connect(nullptr, port);
+    }
+    inline int connect(const char* host, uint16_t port) override;
+
+    size_t write(uint8_t data) override {
+        return write(&data, 1);
+    }
+    size_t write(const uint8_t* buf, size_t size) override {
+        if (!_out || _out->closed) return 0;
+        _out->data.append((const char*)buf, size);
+        return size;
+    }
+    // окно как у сокета: место освобождается, когда другая сторона читает
+    int availableForWrite() override {
+        if (!_out || _out->closed) return 0;
+        return _out->size() < LOOPBACK_WINDOW ? LOOPBACK_WINDOW - _out->size() : 0;
+    }
+
+    int available() override {
+        return _in ? _in->size() : 0;
+    }
+    int read() override {
+        uint8_t b;
+        return read(&b, 1) == 1 ? b : -1;
+    }
+    int read(uint8_t* buf, size_t size) override {
+        if (!_in || !_in->size()) return -1;
+        size = std::min(size, _in->size());
+        memcpy(buf, _in->data.data() + _in->pos, size);
+        _in->pos += size;
+        if (_in->pos == _in->data.size()) {
+            _in->data.clear();
+            _in->pos = 0;
+        }
+        return size;
+    }
+    // данные приходят только от другой стороны в этом же потоке, поэтому чтение не ждёт
+    size_t readBytes(char* buf, size_t len) override {
+        int n = read((uint8_t*)buf, len);
+        return n > 0 ? n : 0;
+    }
+    using Stream::readBytes;
+
+    int peek() override {
+        return available() ? (uint8_t)_in->data[_in->pos] : -1;
+    }
+    void flush() override {}
+    void stop() override {
+        if (_in) _in->closed = true;
+        if (_out) _out->closed = true;
+        _in.reset();
+        _out.reset();
+    }
+    uint8_t connected() override {
+        return _in && (!_in->closed || _in->size());
+    }
+    operator bool() override {
+        return (bool)_in;
+    }
+
+   private:
+    std::shared_ptr<Pipe> _in, _out;
+};
+
+// сервер в памяти. Клиенты подключаются по номеру порта через LoopbackClient::connect
+class LoopbackServer {
+    friend class LoopbackClient;
+
+   public:
+    LoopbackServer(uint16_t port) : _port(port) {}
+    ~LoopbackServer() {
+        if (_servers()[_port] == this) _servers().erase(_port);
+    }
+
+    bool begin() {
+        _servers()[_port] = this;
+        return true;
+    }
+
+    LoopbackClient accept() {
+        if (_pending.empty()) return LoopbackClient();
+        LoopbackClient client = _pending.front();
+        _pending.erase(_pending.begin());
+        return client;
+    }
+    LoopbackClient available() {
+        return accept();
+    }
+
+   private:
+    uint16_t _port;
+    std::vector<LoopbackClient> _pending;
+
+    // реестр не удаляется: глобальный сервер создан раньше него и разрушается позже
+    static std::map<uint16_t, LoopbackServer*>& _servers() {
+        static auto* servers = new std::map<uint16_t, LoopbackServer*>();
+        return *servers;
+    }
+};
+
+int LoopbackClient::connect(const char* host, uint16_t port) {
+    stop();
+    auto it = LoopbackServer::_servers().find(port);
+    if (it == LoopbackServer::_servers().end()) return 0;
+
+    LoopbackClient peer;
+    _in = peer._out = std::make_shared<Pipe>();
+    _out = peer._in = std::make_shared<Pipe>();
+    it->second->_pending.push_back(peer);
+    return 1;
+}
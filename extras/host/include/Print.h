@@ -0,0 +1,69 @@
+#pragma once
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "Printable.h"
+#include "WString.h"
+
+#ifndef DEC
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+#endif
+
+class Print {
+   public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t) = 0;
+    virtual size_t write(const uint8_t* buf, size_t len) {
+        size_t n = 0;
+        while (len-- && write(*buf++)) n++;
+        return n;
+    }
+    size_t write(const char* s) { return s ? write((const uint8_t*)s, strlen(s)) : 0; }
+    size_t write(const char* buf, size_t len) { return write((const uint8_t*)buf, len); }
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() {}
+
+    size_t print(const __FlashStringHelper* s) { return write((const char*)s); }
+    size_t print(const String& s) { return write(s.c_str(), s.length()); }
+    size_t print(const char* s) { return write(s); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char v, int base = DEC) { return print((unsigned long)v, base); }
+    size_t print(int v, int base = DEC) { return print((long)v, base); }
+    size_t print(unsigned v, int base = DEC) { return print((unsigned long)v, base); }
+    size_t print(long v, int base = DEC) {
+        if (v < 0 && base == DEC) return print('-') + print(-(unsigned long)v, base);
+        return print((unsigned long)v, base);
+    }
+    size_t print(unsigned long v, int base = DEC) { return print(String(v, base)); }
+    size_t print(long long v, int base = DEC) { return print(String(v)); }
+    size_t print(unsigned long long v, int base = DEC) { return print(String(v)); }
+    size_t print(double v, int dec = 2) { return print(String(v, dec)); }
+    size_t print(const Printable& p) { return p.printTo(*this); }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(const T& v) { return print(v) + println(); }
+    template <typename T>
+    size_t println(const T& v, int base) { return print(v, base) + println(); }
+
+    size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        char buf[256];
+        va_list args;
+        va_start(args, fmt);
+        int len = vsnprintf(buf, sizeof(buf), fmt, args);
+        va_end(args);
+        if (len < 0) return 0;
+        if ((size_t)len < sizeof(buf)) return write(buf, len);
+        std::string big(len + 1, 0);
+        va_start(args, fmt);
+        vsnprintf(&big[0], len + 1, fmt, args);
+        va_end(args);
+        return write(big.c_str(), len);
+    }
+};
@@ -0,0 +1,58 @@
+#pragma once
+#include "Print.h"
+
+uint32_t millis();
+
+class Stream : public Print {
+   public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long tout) { _timeout = tout; }
+    unsigned long getTimeout() { return _timeout; }
+
+    virtual size_t readBytes(char* buf, size_t len) {
+        size_t n = 0;
+        while (n < len) {
+            int c = timedRead();
+            if (c < 0) break;
+            buf[n++] = c;
+        }
+        return n;
+    }
+    size_t readBytes(uint8_t* buf, size_t len) { return readBytes((char*)buf, len); }
+    size_t readBytesUntil(char term, char* buf, size_t len) {
+        size_t n = 0;
+        while (n < len) {
+            int c = timedRead();
+            if (c < 0 || c == term) break;
+            buf[n++] = c;
+        }
+        return n;
+    }
+    String readString() {
+        String s;
+        int c;
+        while ((c = timedRead()) >= 0) s += (char)c;
+        return s;
+    }
+    String readStringUntil(char term) {
+        String s;
+        int c;
+        while ((c = timedRead()) >= 0 && c != term) s += (char)c;
+        return s;
+    }
+
+   protected:
+    unsigned long _timeout = 1000;
+
+    int timedRead() {
+        uint32_t start = millis();
+        do {
+            int c = read();
+            if (c >= 0) return c;
+        } while (millis() - start < _timeout);
+        return -1;
+    }
+};
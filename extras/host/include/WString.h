@@ -0,0 +1,207 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <string>
+
+class __FlashStringHelper;
+
+// String на основе std::string с интерфейсом Arduino
+class String {
+   public:
+    String(const char* s = "") {
+        if (s) _s = s;
+    }
+    String(const char* s, unsigned len) : _s(s, len) {}
+    String(const __FlashStringHelper* s) : String((const char*)s) {}
+    String(const String& s) = default;
+    String(String&& s) = default;
+    explicit String(char c) : _s(1, c) {}
+    explicit String(unsigned char v, unsigned char base = 10) : String((unsigned long)v, base) {}
+    explicit String(int v, unsigned char base = 10) : String((long)v, base) {}
+    explicit String(unsigned v, unsigned char base = 10) : String((unsigned long)v, base) {}
+    explicit String(long v, unsigned char base = 10) {
+        char buf[8 * sizeof(long) + 2];
+        if (base == 10) snprintf(buf, sizeof(buf), "%ld", v);
+        else _utoa((unsigned long)v, buf, base);
+        _s = buf;
+    }
+    explicit String(unsigned long v, unsigned char base = 10) {
+        char buf[8 * sizeof(long) + 1];
+        _utoa(v, buf, base);
+        _s = buf;
+    }
+    explicit String(long long v) : _s(std::to_string(v)) {}
+    explicit String(unsigned long long v) : _s(std::to_string(v)) {}
+    explicit String(float v, unsigned char dec = 2) : String((double)v, dec) {}
+    explicit String(double v, unsigned char dec = 2) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%.*f", dec, v);
+        _s = buf;
+    }
+
+    String& operator=(const String& s) = default;
+    String& operator=(String&& s) = default;
+    String& operator=(const char* s) {
+        _s = s ? s : "";
+        return *this;
+    }
+    String& operator=(const __FlashStringHelper* s) { return *this = (const char*)s; }
+
+    bool reserve(unsigned size) {
+        _s.reserve(size);
+        return true;
+    }
+    unsigned length() const { return _s.length(); }
+    bool isEmpty() const { return _s.empty(); }
+    const char* c_str() const { return _s.c_str(); }
+    char* begin() { return &_s[0]; }
+    char* end() { return &_s[0] + _s.length(); }
+    const char* begin() const { return _s.c_str(); }
+    const char* end() const { return _s.c_str() + _s.length(); }
+
+    bool concat(const String& s) { return _cat(s._s.data(), s._s.length()); }
+    bool concat(const char* s) { return s ? _cat(s, strlen(s)) : false; }
+    bool concat(const char* s, unsigned len) { return s ? _cat(s, len) : false; }
+    bool concat(const uint8_t* s, unsigned len) { return concat((const char*)s, len); }
+    bool concat(const __FlashStringHelper* s) { return concat((const char*)s); }
+    bool concat(char c) { return _cat(&c, 1); }
+    bool concat(unsigned char v) { return concat(String(v)); }
+    bool concat(int v) { return concat(String(v)); }
+    bool concat(unsigned v) { return concat(String(v)); }
+    bool concat(long v) { return concat(String(v)); }
+    bool concat(unsigned long v) { return concat(String(v)); }
+    bool concat(long long v) { return concat(String(v)); }
+    bool concat(unsigned long long v) { return concat(String(v)); }
+    bool concat(float v) { return concat(String(v)); }
+    bool concat(double v) { return concat(String(v)); }
+
+    template <typename T>
+    String& operator+=(const T& v) {
+        concat(v);
+        return *this;
+    }
+
+    int compareTo(const String& s) const { return strcmp(c_str(), s.c_str()); }
+    bool equals(const String& s) const { return _s == s._s; }
+    bool equals(const char* s) const { return s && _s == s; }
+    bool equalsIgnoreCase(const String& s) const { return _s.length() == s._s.length() && !strcasecmp(c_str(), s.c_str()); }
+    bool operator==(const String& s) const { return equals(s); }
+    bool operator==(const char* s) const { return equals(s); }
+    bool operator!=(const String& s) const { return !equals(s); }
+    bool operator!=(const char* s) const { return !equals(s); }
+    bool operator<(const String& s) const { return compareTo(s) < 0; }
+    bool operator>(const String& s) const { return compareTo(s) > 0; }
+    bool startsWith(const String& s, unsigned from = 0) const { return _s.compare(from, s._s.length(), s._s) == 0 && from + s._s.length() <= _s.length(); }
+    bool endsWith(const String& s) const { return _s.length() >= s._s.length() && !_s.compare(_s.length() - s._s.length(), s._s.length(), s._s); }
+
+    char charAt(unsigned i) const { return i < _s.length() ? _s[i] : 0; }
+    void setCharAt(unsigned i, char c) {
+        if (i < _s.length()) _s[i] = c;
+    }
+    char operator[](unsigned i) const { return charAt(i); }
+    char& operator[](unsigned i) { return _s[i]; }
+    void getBytes(unsigned char* buf, unsigned size, unsigned from = 0) const { toCharArray((char*)buf, size, from); }
+    void toCharArray(char* buf, unsigned size, unsigned from = 0) const {
+        if (!size) return;
+        unsigned n = from < _s.length() ? std::min<size_t>(size - 1, _s.length() - from) : 0;
+        memcpy(buf, _s.data() + from, n);
+        buf[n] = 0;
+    }
+
+    int indexOf(char c, unsigned from = 0) const { return _pos(_s.find(c, from)); }
+    int indexOf(const String& s, unsigned from = 0) const { return _pos(_s.find(s._s, from)); }
+    int lastIndexOf(char c) const { return _pos(_s.rfind(c)); }
+    int lastIndexOf(char c, unsigned from) const { return _pos(_s.rfind(c, from)); }
+    int lastIndexOf(const String& s) const { return _pos(_s.rfind(s._s)); }
+    String substring(unsigned from) const { return substring(from, _s.length()); }
+    String substring(unsigned from, unsigned to) const {
+        if (from > to) std::swap(from, to);
+        if (from >= _s.length()) return String();
+        return String(_s.data() + from, std::min<size_t>(to, _s.length()) - from);
+    }
+
+    void replace(char a, char b) {
+        for (char& c : _s) {
+            if (c == a) c = b;
+        }
+    }
+    void replace(const String& a, const String& b) {
+        if (!a.length()) return;
+        for (size_t p = 0; (p = _s.find(a._s, p)) != std::string::npos; p += b._s.length()) _s.replace(p, a._s.length(), b._s);
+    }
+    void remove(unsigned from) {
+        if (from < _s.length()) _s.erase(from);
+    }
+    void remove(unsigned from, unsigned count) {
+        if (from < _s.length()) _s.erase(from, count);
+    }
+    void toLowerCase() {
+        for (char& c : _s) c = tolower(c);
+    }
+    void toUpperCase() {
+        for (char& c : _s) c = toupper(c);
+    }
+    void trim() {
+        size_t a = _s.find_first_not_of(" \t\r\n\v\f");
+        if (a == std::string::npos) return _s.clear();
+        _s = _s.substr(a, _s.find_last_not_of(" \t\r\n\v\f") - a + 1);
+    }
+
+    long toInt() const { return atol(c_str()); }
+    float toFloat() const { return atof(c_str()); }
+    double toDouble() const { return atof(c_str()); }
+
+    explicit operator bool() const { return true; }
+
+   protected:
+    std::string _s;
+
+    bool _cat(const char* s, size_t len) {
+        _s.append(s, len);
+        return true;
+    }
+    static int _pos(size_t p) { return p == std::string::npos ? -1 : (int)p; }
+    static void _utoa(unsigned long v, char* buf, unsigned char base) {
+        char tmp[8 * sizeof(long) + 1];
+        char* p = tmp + sizeof(tmp) - 1;
+        *p = 0;
+        if (base < 2 || base > 36) base = 10;
+        do {
+            char d = v % base;
+            *--p = d < 10 ? d + '0' : d - 10 + 'a';
+            v /= base;
+        } while (v);
+        strcpy(buf, p);
+    }
+};
+
+inline String operator+(const String& a, const String& b) {
+    String s(a);
+    s += b;
+    return s;
+}
+inline String operator+(const String& a, const char* b) {
+    String s(a);
+    s += b;
+    return s;
+}
+inline String operator+(const char* a, const String& b) {
+    String s(a);
+    s += b;
+    return s;
+}
+inline String operator+(const String& a, char b) {
+    String s(a);
+    s += b;
+    return s;
+}
+template <typename T>
+inline String operator+(const String& a, T b) {
+    String s(a);
+    s += b;
+    return s;
+}
@@ -1,7 +1,11 @@
 #pragma once
 
+#include "./utils/BlockPool.h"
 #include "./utils/Client.h"
+#include "./utils/ClientPool.h"
 #include "./utils/EspClient.h"
+#include "./utils/Gzip.h"
 #include "./utils/HeadersParser.h"
+#include "./utils/Multipart.h"
 #include "./utils/Server.h"
 #include "./utils/ServerBase.h"
\ No newline at end of file
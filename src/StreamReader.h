@@ -2,6 +2,8 @@
 #include <Arduino.h>
 #include <StringUtils.h>
 
+#include "utils/BlockPool.h"
+#include "utils/Gzip.h"
 #include "utils/cfg.h"
 
 #define READER_LENSTR_LEN 10
@@ -16,6 +18,28 @@ class StreamReader : public Stream {
         }
     };
 
+    class Discard {
+       public:
+        size_t write(uint8_t*, size_t len) {
+            return len;
+        }
+    };
+
+    // распаковка gzip перед выводом
+    template <typename T>
+    class Inflate {
+       public:
+        Inflate(ghttp::GzipReader& gz, T& p) : _gz(gz), _p(p) {}
+
+        size_t write(uint8_t* data, size_t len) {
+            return _gz.decode(data, len, _p) ? len : 0;
+        }
+
+       private:
+        ghttp::GzipReader& _gz;
+        T& _p;
+    };
+
    public:
     class Buffer {
        public:
@@ -41,6 +65,11 @@ class StreamReader : public Stream {
         _bsize = bsize;
     }
 
+    // адаптивный размер блока: читать всё доступное, не больше GHTTP_BLOCK_MAX
+    void setAdaptive(bool adaptive) {
+        _adaptive = adaptive;
+    }
+
     void setTimeout(size_t tout) {
         _tout = tout;
         if (stream) stream->setTimeout(tout);
@@ -51,6 +80,18 @@ class StreamReader : public Stream {
         return _chunked;
     }
 
+    // распаковывать тело gzip в writeTo (readString, readBuffer). nullptr - не распаковывать.
+    // readBytes и read читают сжатые данные, length() - оставшийся размер сжатых
+    void setGzip(ghttp::GzipReader* gz) {
+        _gz = gz;
+        if (gz) gz->begin();
+    }
+
+    // тело распаковывается
+    bool isGzip() {
+        return _gz;
+    }
+
     // корреткность ридера
     operator bool() {
         return available();
@@ -95,144 +136,201 @@ class StreamReader : public Stream {
         return s;
     }
 
+    // пропустить оставшиеся данные без распаковки. Вернёт количество пропущенных
+    size_t skip() {
+        Discard d;
+        return _writeTo(d);
+    }
+
     size_t readBytes(char* buffer, size_t length) {
         if (!stream) return 0;
 
         if (_chunked) {
-            size_t wasread = 0;
-            while (length) {
-                GHTTP_ESP_YIELD();
-                if (_chunklen) {
-                    size_t curlen = min(_chunklen, length);
-                    size_t read = stream->readBytes(buffer, curlen);
-                    wasread += read;
-                    buffer += curlen;
-                    length -= curlen;
-                    _chunklen -= curlen;
-
-                    if (read != curlen) {  // read error
-                        stream = nullptr;
-                        break;
-                    }
-
-                    if (!_chunklen) {
-                        if (!_endChunk()) {  // chunked end error
-                            stream = nullptr;
-                            break;
-                        }
-                    }
-
-                } else {
-                    int chlen = _readChunkLen();
-                    if (chlen <= 0) {
-                        if (chlen < 0) {
-                            // read len error
-                        }
-                        if (!chlen) {
-                            if (!_endChunk()) {
-                                // chunked end error
-                            }
-                        }
-                        stream = nullptr;
-                        break;
-                    }
-                    _chunklen = chlen;
-                }
-            }
-            return wasread;
-
+            size_t read = _readChunked(buffer, length);
+            GHTTP_METRIC(received += read;)
+            return read;
         } else {
             if (length > _len) length = _len;
             _len -= length;
             size_t read = stream->readBytes(buffer, length);
             if (!_len) stream = nullptr;
+            GHTTP_METRIC(received += read;)
             return read;
         }
         return 0;
     }
 
-    // вывести всё в write(uint8_t*, size_t). Вернёт количество записанных или 0 при ошибке
+    // вывести всё в write(uint8_t*, size_t). Вернёт количество записанных (распакованных) или 0 при ошибке
     template <typename T>
     size_t writeTo(T& p) {
+        if (!_gz) return _writeTo(p);
+        Inflate<T> inflate(*_gz, p);
+        if (!_writeTo(inflate) || !_gz->done()) return 0;
+        return _gz->length();
+    }
+
+    Stream* stream = nullptr;
+    GHTTP_METRIC(size_t received = 0;)  // прочитано байт тела
+
+   private:
+    size_t _len;
+    size_t _bsize = 128;
+    bool _adaptive = GHTTP_ADAPTIVE_BLOCKS;
+    bool _chunked = false;
+    size_t _chunklen = 0;
+    size_t _tout;
+    bool _error = false;
+    ghttp::GzipReader* _gz = nullptr;
+
+    template <typename T>
+    size_t _writeTo(T& p) {
         if (!stream) return 0;
-        uint8_t* buf = new uint8_t[_chunked ? _bsize : min(_bsize, _len)];
-        if (!buf) return 0;
+        size_t bsize = _adaptive ? GHTTP_BLOCK_MAX : _bsize;
+        ghttp::PoolBlock block(_chunked ? bsize : min(bsize, _len));
+        if (!block) return 0;
+        uint8_t* buf = block.buf();
 
         size_t writed = 0;
         if (_chunked) {
-            char lenstr[READER_LENSTR_LEN];
-            while (1) {
-                GHTTP_ESP_YIELD();
-
-                bool last = 0;
-                size_t len = stream->readBytesUntil('\n', lenstr, READER_LENSTR_LEN);
-                if (!len || lenstr[len - 1] != '\r') {
-                    writed = 0;
+            while (stream) {
+                size_t len = _readChunked((char*)buf, block.size());
+                if (!len) break;
+                if (p.write(buf, len) != len) {
+                    _error = true;
                     break;
                 }
-
-                len = su::strToIntHex(lenstr, len - 1);
-                if (len) {
-                    size_t w = _writeBuffered(len, buf, p);
-                    if (w != len) {
-                        writed = 0;
-                        break;
-                    }
-                    writed += w;
-                } else {
-                    last = 1;
-                }
-
-                len = stream->readBytesUntil('\n', lenstr, READER_LENSTR_LEN);
-                if (len != 1 || lenstr[0] != '\r') {
-                    writed = 0;
-                    break;
-                }
-
-                if (last) break;
+                writed += len;
             }
+            if (_error) writed = 0;
 
         } else {
-            writed = _writeBuffered(_len, buf, p);
+            writed = _writeBuffered(_len, buf, block.size(), p);
         }
 
-        delete[] buf;
         _len = 0;
         stream = nullptr;
+        GHTTP_METRIC(received += writed;)
         return writed;
     }
 
-    Stream* stream = nullptr;
+    // уже прочитанные из потока байты служебных строк chunked. Из потока читается только то,
+    // что гарантированно относится к телу - данные следующего запроса в потоке не затрагиваются
+    uint8_t _ahead[READER_LENSTR_LEN] = {};
+    uint8_t _alen = 0;
 
-   private:
-    size_t _len;
-    size_t _bsize = 128;
-    bool _chunked = false;
-    size_t _chunklen = 0;
-    size_t _tout;
+    size_t _readChunked(char* buffer, size_t length) {
+        size_t wasread = 0;
+        while (length && stream) {
+            GHTTP_ESP_YIELD();
+            if (!_chunklen) {
+                if (!_nextChunk()) break;
+                continue;
+            }
 
-    // -1 error
-    int _readChunkLen() {
-        char lenstr[READER_LENSTR_LEN];
-        size_t len = stream->readBytesUntil('\n', lenstr, READER_LENSTR_LEN);
-        if (len < 2 || lenstr[len - 1] != '\r') return -1;
-        return su::strToIntHex(lenstr, len - 1);
+            size_t curlen = min(_chunklen, length);
+            size_t n = min(curlen, (size_t)_alen);
+            if (n) {
+                memcpy(buffer, _ahead, n);
+                _drop(n);
+            }
+            if (curlen > n) {
+                size_t read = stream->readBytes(buffer + n, curlen - n);
+                n += read;
+                if (n != curlen) _fail();  // read error
+            }
+            wasread += n;
+            buffer += n;
+            length -= n;
+            _chunklen -= n;
+
+            if (stream && !_chunklen) {
+                // \r\n после данных и минимальная строка следующего размера ("0\r\n") одним чтением
+                if (!_fill(5) || _ahead[0] != '\r' || _ahead[1] != '\n') _fail();
+                else _drop(2);
+            }
+        }
+        return wasread;
     }
-    bool _endChunk() {
-        char r, n;
-        stream->readBytes(&r, 1);
-        stream->readBytes(&n, 1);
-        return (r == '\r' && n == '\n');
+
+    // прочитать строку размера следующего chunk. false - тело закончилось или ошибка
+    bool _nextChunk() {
+        int16_t len = _line(3);
+        if (len == -1 || !len || !isxdigit(_ahead[0])) return _fail();
+
+        uint8_t end = 0;
+        while (end < _alen && isxdigit(_ahead[end])) end++;  // расширения chunk не используются
+        _chunklen = su::strToIntHex((const char*)_ahead, end);
+        if (!_skipLine()) return _fail();
+        if (_chunklen) return true;
+
+        // последний chunk, трейлеры до пустой строки пропускаются
+        do {
+            len = _line(2);
+            if (len == -1 || !_skipLine()) return _fail();
+        } while (len);
+        stream = nullptr;
+        return false;
+    }
+
+    // дочитать в буфер строку до \r\n. minlen - минимальная длина строки.
+    // Вернёт длину без \r\n, -1 при ошибке, -2 если строка длиннее буфера (в буфере её начало)
+    int16_t _line(uint8_t minlen) {
+        while (1) {
+            const uint8_t* nl = (const uint8_t*)memchr(_ahead, '\n', _alen);
+            if (nl) {
+                int16_t len = nl - _ahead;
+                return (len && _ahead[len - 1] == '\r') ? len - 1 : -1;
+            }
+            if (_alen == READER_LENSTR_LEN) return -2;
+            uint8_t need = _alen ? (_ahead[_alen - 1] == '\r' ? 1 : 2) : minlen;
+            if (!_fill(min(_alen + need, READER_LENSTR_LEN))) return -1;
+        }
+    }
+
+    // пропустить текущую строку до \n включительно
+    bool _skipLine() {
+        const uint8_t* nl = (const uint8_t*)memchr(_ahead, '\n', _alen);
+        if (nl) {
+            _drop(nl - _ahead + 1);
+            return true;
+        }
+        _alen = 0;
+        char c;
+        while (stream->readBytes(&c, 1)) {
+            if (c == '\n') return true;
+        }
+        return false;
+    }
+
+    // дочитать в буфер до len байт
+    bool _fill(uint8_t len) {
+        if (len > READER_LENSTR_LEN) return false;
+        if (_alen >= len) return true;
+        uint8_t need = len - _alen;
+        uint8_t read = stream->readBytes(_ahead + _alen, need);
+        _alen += read;
+        return read == need;
+    }
+
+    void _drop(uint8_t len) {
+        memmove(_ahead, _ahead + len, _alen - len);
+        _alen -= len;
+    }
+
+    bool _fail() {
+        _error = true;
+        stream = nullptr;
+        return false;
     }
 
     template <typename T>
-    size_t _writeBuffered(size_t len, uint8_t* buffer, T& p) {
+    size_t _writeBuffered(size_t len, uint8_t* buffer, size_t bsize, T& p) {
         size_t left = len;
         while (left) {
             GHTTP_ESP_YIELD();
             if (!_waitStream()) break;
 
-            size_t block = min(min(left, (size_t)stream->available()), _bsize);
+            size_t block = min(min(left, (size_t)stream->available()), bsize);
             size_t read = stream->readBytes(buffer, block);
             GHTTP_ESP_YIELD();
 
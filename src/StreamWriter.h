@@ -1,8 +1,13 @@
 #pragma once
 #include <Arduino.h>
 
+#include "utils/BlockPool.h"
 #include "utils/cfg.h"
 
+#if defined(ESP8266) || defined(ESP32)
+#include <FS.h>
+#endif
+
 #define WRITER_PRINT_BLOCK_SIZE 512
 
 // ==================== SENDER ====================
@@ -14,6 +19,9 @@ class StreamWriter : public Printable {
     StreamWriter(const char* buf, int16_t len = -1, bool pgm = 0) : _buf((const uint8_t*)buf), _len(len >= 0 ? len : (pgm ? strlen_P(buf) : strlen(buf))), _pgm(pgm) {}
     StreamWriter(const __FlashStringHelper* str) : _buf((const uint8_t*)str), _len(strlen_P((PGM_P)str)), _pgm(true) {}
     StreamWriter(String& s) : _buf((const uint8_t*)s.c_str()), _len(s.length()), _pgm(false) {}
+#ifdef FS_H
+    StreamWriter(File* file) : _stream(file), _len(file->size()), _file(file) {}
+#endif
 
     // размер данных
     size_t length() const {
@@ -25,9 +33,93 @@ class StreamWriter : public Printable {
         _bsize = bsize;
     }
 
+    // адаптивный размер блока: по свободному месту в буфере отправки, кратно MSS, не больше GHTTP_BLOCK_MAX
+    void setAdaptive(bool adaptive) {
+        _adaptive = adaptive;
+    }
+
+    // размер блока под свободное место writable в буфере отправки: целое число сегментов MSS, не больше max.
+    // Вернёт 0, если места меньше сегмента и остаток left в него не помещается
+    static size_t segmentBlock(size_t writable, size_t left, size_t max = GHTTP_BLOCK_MAX) {
+        size_t len = min(writable, max);
+        if (len >= left) return left;
+        if (max < GHTTP_TCP_MSS) return len;
+        return len - len % GHTTP_TCP_MSS;
+    }
+
+    // осталось отправить через printNext
+    size_t left() const {
+        return _len - _pos;
+    }
+
+    // ограничить вывод диапазоном байт [from, from + len). Вызывать до начала отправки.
+    // File перематывается через seek, из другого Stream начальные байты вычитываются
+    bool setRange(size_t from, size_t len) {
+        if (_pos || from > _len) return false;
+        len = min(len, _len - from);
+        if (_stream) {
+#ifdef FS_H
+            if (_file) {
+                if (!_file->seek(from)) return false;
+            } else
+#endif
+            {
+                uint8_t buf[32];
+                for (size_t skip = from; skip;) {
+                    size_t read = _stream->readBytes(buf, min(skip, sizeof(buf)));
+                    if (!read) return false;
+                    skip -= read;
+                }
+            }
+        }
+        _pos = from;
+        _len = from + len;
+        return true;
+    }
+
+    // прочитать следующую порцию данных в буфер buf не больше size байт. Вернёт количество прочитанных
+    size_t readNext(uint8_t* buf, size_t size) {
+        size_t len = min(size, left());
+        if (!len) return 0;
+
+        if (_stream) {
+            len = min(len, (size_t)_stream->available());
+            size_t read = _stream->readBytes(buf, len);
+            if (read != len) _pos = _len;  // read error
+            len = read;
+        } else if (_buf) {
+            if (_pgm) memcpy_P(buf, _buf + _pos, len);
+            else memcpy(buf, _buf + _pos, len);
+        }
+        _pos += len;
+        if (_pos > _len) _pos = _len;
+        return len;
+    }
+
+    // отправить следующую порцию данных не больше size байт, используя буфер buf. Вернёт количество отправленных
+    size_t printNext(Print& p, uint8_t* buf, size_t size) {
+        size_t len = min(size, left());
+        if (!len) return 0;
+
+        size_t printed = 0;
+#if !defined(ESP32)
+        if (_buf && !_pgm) {
+#else
+        if (_buf) {
+#endif
+            printed = p.write(_buf + _pos, len);
+            _pos += printed;
+        } else {
+            len = readNext(buf, len);
+            printed = p.write(buf, len);
+        }
+        if (printed != len) _pos = _len;  // write error
+        return printed;
+    }
+
     // напечатать в принт
     size_t printTo(Print& p) const {
-        if (!_len) return 0;
+        if (!left()) return 0;
         if (_stream) return _printStream(p);
         else if (_buf) return _pgm ? _printPGM(p) : _print(p);
         return 0;
@@ -37,28 +129,41 @@ class StreamWriter : public Printable {
     Stream* _stream = nullptr;
     const uint8_t* _buf = nullptr;
     size_t _len = 0;
+    size_t _pos = 0;
     bool _pgm = 0;
+#ifdef FS_H
+    File* _file = nullptr;
+#endif
 
    private:
     size_t _bsize = 128;
+    bool _adaptive = GHTTP_ADAPTIVE_BLOCKS;
+
+    // размер следующего блока для отправки в p
+    size_t _block(Print& p, size_t left, size_t max) const {
+        if (!_adaptive) return min(left, max);
+        int avail = p.availableForWrite();
+        size_t len = segmentBlock(avail > 0 ? avail : max, left, max);
+        return len ? len : min(left, (size_t)GHTTP_TCP_MSS);  // ожидание места в write()
+    }
 
     size_t _printStream(Print& p) const {
         if (!_stream->available()) return 0;
-        uint8_t* buf = new uint8_t[min(_bsize, _len)];
-        if (!buf) return 0;
+        size_t left = this->left();
+        ghttp::PoolBlock block(min(_adaptive ? GHTTP_BLOCK_MAX : _bsize, left));
+        if (!block) return 0;
+        uint8_t* buf = block.buf();
 
-        size_t left = _len;
         size_t printed = 0;
 
         while (left) {
             GHTTP_ESP_YIELD();
-            size_t len = min(min(left, (size_t)_stream->available()), _bsize);
+            size_t len = min(_block(p, left, block.size()), (size_t)_stream->available());
             size_t read = _stream->readBytes(buf, len);
             printed += p.write(buf, read);
             if (len != read) break;
             left -= len;
         }
-        delete[] buf;
         return printed;
     }
 
@@ -66,42 +171,41 @@ class StreamWriter : public Printable {
 #if defined(ESP32)
         return _print(p);
 #else
-        const uint8_t* bytes = _buf;
-        uint8_t* buf = new uint8_t[min(_bsize, _len)];
-        if (!buf) return 0;
+        const uint8_t* bytes = _buf + _pos;
+        size_t left = this->left();
+        ghttp::PoolBlock block(min(_adaptive ? GHTTP_BLOCK_MAX : _bsize, left));
+        if (!block) return 0;
+        uint8_t* buf = block.buf();
 
-        size_t left = _len;
         size_t printed = 0;
 
         while (left) {
             GHTTP_ESP_YIELD();
-            size_t len = min(_bsize, left);
+            size_t len = _block(p, left, block.size());
             memcpy_P(buf, bytes, len);
             printed += p.write(buf, len);
             bytes += len;
             left -= len;
         }
-        delete[] buf;
         return printed;
 #endif
     }
     
     size_t _print(Print& p) const {
 #if defined(ESP8266)
-        return p.write(_buf, _len);
-#elif defined(ESP32)
-        size_t left = _len;
+        if (!_adaptive) return p.write(_buf + _pos, left());
+#elif !defined(ESP32)
+        return p.write(_buf + _pos, left());
+#endif
+        size_t left = this->left();
         size_t printed = 0;
-        const uint8_t* bytes = _buf;
+        const uint8_t* bytes = _buf + _pos;
         while (left) {
-            size_t curlen = min(left, (size_t)WRITER_PRINT_BLOCK_SIZE);
+            size_t curlen = _block(p, left, _adaptive ? GHTTP_BLOCK_MAX : WRITER_PRINT_BLOCK_SIZE);
             printed += p.write(bytes, curlen);
             left -= curlen;
             bytes += curlen;
         }
         return printed;
-#else
-        return p.write(_buf, _len);
-#endif
     }
 };
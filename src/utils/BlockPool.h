@@ -0,0 +1,142 @@
+#pragma once
+#include <Arduino.h>
+
+#include "cfg.h"
+
+#ifndef GHTTP_POOL_BLOCKS
+#ifdef __AVR__
+#define GHTTP_POOL_BLOCKS 0         // количество блоков в пуле. 0 - блоки выделяются в куче на каждую передачу
+#else
+#define GHTTP_POOL_BLOCKS 2         // количество блоков в пуле. 0 - блоки выделяются в куче на каждую передачу
+#endif
+#endif
+
+#ifndef GHTTP_POOL_BLOCK_SIZE
+#if GHTTP_ADAPTIVE_BLOCKS
+#define GHTTP_POOL_BLOCK_SIZE GHTTP_BLOCK_MAX  // размер блока пула
+#else
+#define GHTTP_POOL_BLOCK_SIZE 512   // размер блока пула
+#endif
+#endif
+
+#ifndef GHTTP_POOL_FALLBACK
+#define GHTTP_POOL_FALLBACK 1       // при исчерпании пула: 1 - выделить блок в куче, 0 - отказать
+#endif
+
+// #define GHTTP_POOL_STATIC        // блоки пула в статической памяти, иначе выделяются в куче один раз при первом использовании
+
+namespace ghttp {
+
+// пул блоков фиксированного размера для передачи данных. Блоки не освобождаются, поэтому
+// частые передачи не фрагментируют кучу
+class BlockPool {
+   public:
+    struct Stats {
+        uint32_t taken = 0;     // выдано блоков из пула
+        uint32_t fallback = 0;  // выделено в куче при исчерпании пула
+        uint32_t failed = 0;    // отказано
+        uint8_t used = 0;       // занято блоков сейчас
+        uint8_t peak = 0;       // макс. занято блоков
+    };
+
+    // взять блок. size - желаемый размер, будет уменьшен до размера блока пула. nullptr при отказе
+    static uint8_t* take(size_t& size) {
+        State& s = _state();
+#if GHTTP_POOL_BLOCKS
+        for (uint8_t i = 0; i < GHTTP_POOL_BLOCKS; i++) {
+            if (s.busy[i]) continue;
+#ifndef GHTTP_POOL_STATIC
+            if (!s.blocks[i]) s.blocks[i] = new uint8_t[GHTTP_POOL_BLOCK_SIZE];
+            if (!s.blocks[i]) break;
+#endif
+            s.busy[i] = true;
+            s.stats.taken++;
+            if (++s.stats.used > s.stats.peak) s.stats.peak = s.stats.used;
+            size = min(size, (size_t)GHTTP_POOL_BLOCK_SIZE);
+            return s.blocks[i];
+        }
+#endif
+#if GHTTP_POOL_FALLBACK
+        uint8_t* buf = new uint8_t[size];
+        if (buf) {
+            s.stats.fallback++;
+            return buf;
+        }
+#endif
+        s.stats.failed++;
+        return nullptr;
+    }
+
+    // вернуть блок
+    static void give(uint8_t* buf) {
+        if (!buf) return;
+        State& s = _state();
+#if GHTTP_POOL_BLOCKS
+        for (uint8_t i = 0; i < GHTTP_POOL_BLOCKS; i++) {
+            if (s.blocks[i] == buf) {
+                s.busy[i] = false;
+                s.stats.used--;
+                return;
+            }
+        }
+#endif
+        delete[] buf;
+    }
+
+    // статистика пула
+    static const Stats& stats() {
+        return _state().stats;
+    }
+
+   private:
+    struct State {
+#if GHTTP_POOL_BLOCKS
+#ifdef GHTTP_POOL_STATIC
+        uint8_t blocks[GHTTP_POOL_BLOCKS][GHTTP_POOL_BLOCK_SIZE];
+#else
+        uint8_t* blocks[GHTTP_POOL_BLOCKS] = {};
+#endif
+        bool busy[GHTTP_POOL_BLOCKS] = {};
+#endif
+        Stats stats;
+    };
+
+    static State& _state() {
+        static State state;
+        return state;
+    }
+};
+
+// блок из пула на время жизни объекта
+class PoolBlock {
+   public:
+    PoolBlock(size_t size) : _size(size) {
+        _buf = BlockPool::take(_size);
+    }
+    ~PoolBlock() {
+        BlockPool::give(_buf);
+    }
+
+    PoolBlock(const PoolBlock&) = delete;
+    PoolBlock& operator=(const PoolBlock&) = delete;
+
+    // буфер блока
+    uint8_t* buf() const {
+        return _buf;
+    }
+
+    // размер блока
+    size_t size() const {
+        return _buf ? _size : 0;
+    }
+
+    operator bool() const {
+        return _buf;
+    }
+
+   private:
+    uint8_t* _buf;
+    size_t _size;
+};
+
+}  // namespace ghttp
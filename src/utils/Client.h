@@ -6,14 +6,51 @@
 #include <functional>
 #endif
 
+#include "BlockPool.h"
+#include "Gzip.h"
 #include "HeadersParser.h"
+#include "Metrics.h"
+#include "OutputBuffer.h"
 #include "StreamReader.h"
+#include "StreamWriter.h"
 #include "cfg.h"
 
 #define HC_DEF_TIMEOUT 2000     // таймаут по умолчанию
 #define HC_FLUSH_BLOCK 64       // блок очистки
+
+#ifndef HC_HEADERS_SIZE
+#ifdef __AVR__
+#define HC_HEADERS_SIZE 128     // буфер строки статуса, Content-Type и строки хэдера
+#else
+#define HC_HEADERS_SIZE 384     // буфер строки статуса, Content-Type и строки хэдера
+#endif
+#endif
 #define HC_BOUNDARY "----GyverHttpBoundary123454321"
 
+#ifndef HC_FORM_PARTS
+#ifdef __AVR__
+#define HC_FORM_PARTS 2         // макс. частей FormData из буфера, потока или файла
+#else
+#define HC_FORM_PARTS 4         // макс. частей FormData из буфера, потока или файла
+#endif
+#endif
+
+#ifndef HC_CHUNK_SIZE
+#ifdef __AVR__
+#define HC_CHUNK_SIZE 64        // размер chunk при отправке тела неизвестной длины
+#else
+#define HC_CHUNK_SIZE 512       // размер chunk при отправке тела неизвестной длины
+#endif
+#endif
+
+#ifndef HC_QUEUE_SIZE
+#ifdef __AVR__
+#define HC_QUEUE_SIZE 1         // очередь запросов асинхронного режима
+#else
+#define HC_QUEUE_SIZE 4         // очередь запросов асинхронного режима
+#endif
+#endif
+
 // #define HC_USE_LOG Serial
 
 #ifdef HC_USE_LOG
@@ -26,12 +63,113 @@ namespace ghttp {
 
 class Client : public Print {
    public:
-    // билдер form data
+    // ошибка асинхронного запроса
+    enum class Error : uint8_t {
+        None,
+        Connect,     // не удалось подключиться
+        Timeout,     // нет активности дольше таймаута
+        Disconnect,  // сервер закрыл соединение
+        Parse,       // некорректный ответ
+    };
+
+    // билдер form data. Текстовые поля копируются, данные из буфера, потока и файла не копируются и
+    // читаются при отправке - буфер, поток и файл должны существовать до отправки запроса
     class FormData {
         friend class Client;
 
        public:
+        // добавить часть с текстом (копируется)
         void add(const Text& name, const Text& filename, const Text& type, const Text& data) {
+            _head(name, filename, type);
+            data.addString(s);
+            _tail();
+        }
+
+        // добавить часть из буфера, pgm - буфер в PROGMEM
+        bool add(const Text& name, const Text& filename, const Text& type, const uint8_t* data, size_t len, bool pgm = false) {
+            Part* part = _add(name, filename, type);
+            if (!part) return false;
+            part->buf = data;
+            part->len = len;
+            part->pgm = pgm;
+            return true;
+        }
+
+        // добавить часть из потока длиной len
+        bool add(const Text& name, const Text& filename, const Text& type, Stream& stream, size_t len) {
+            Part* part = _add(name, filename, type);
+            if (!part) return false;
+            part->stream = &stream;
+            part->len = len;
+            return true;
+        }
+
+#ifdef FS_H
+        // добавить файл
+        bool add(const Text& name, const Text& filename, const Text& type, File& file) {
+            Part* part = _add(name, filename, type);
+            if (!part) return false;
+            part->stream = &file;
+            part->file = &file;
+            part->len = file.size();
+            return true;
+        }
+#endif
+
+        // размер тела
+        size_t length() {
+            size_t len = s.length() + 2;
+            for (uint8_t i = 0; i < _count; i++) len += _parts[i].len;
+            return len;
+        }
+
+        // вернуться к началу для повторной отправки. false - часть из потока уже прочитана
+        bool rewind() {
+            for (uint8_t i = 0; i < _count; i++) {
+                Part& part = _parts[i];
+                if (!part.stream || !_started) continue;
+#ifdef FS_H
+                if (part.file && part.file->seek(0)) continue;
+#endif
+                return false;
+            }
+            _seg = 0;
+            _pos = 0;
+            _end = 0;
+            _inPart = _started = false;
+            return true;
+        }
+
+       private:
+        struct Part {
+            uint16_t at = 0;  // позиция в s
+            const uint8_t* buf = nullptr;
+            Stream* stream = nullptr;
+#ifdef FS_H
+            File* file = nullptr;
+#endif
+            size_t len = 0;
+            bool pgm = false;
+        };
+
+        String s;
+        bool _first = true;
+        Part _parts[HC_FORM_PARTS];
+        uint8_t _count = 0;
+
+        // состояние отправки
+        StreamWriter _writer;
+        size_t _pos = 0;
+        uint8_t _seg = 0;
+        uint8_t _end = 0;
+        bool _inPart = false;
+        bool _started = false;
+
+        void clrf() {
+            s += "\r\n";
+        }
+
+        void _head(const Text& name, const Text& filename, const Text& type) {
             if (_first) s += F("--" HC_BOUNDARY);
             _first = false;
             clrf();
@@ -50,16 +188,69 @@ class Client : public Print {
                 clrf();
             }
             clrf();
-            data.addString(s);
+        }
+
+        void _tail() {
             clrf();
             s += F("--" HC_BOUNDARY);
         }
 
-       private:
-        String s;
-        bool _first = true;
-        void clrf() {
-            s += "\r\n";
+        Part* _add(const Text& name, const Text& filename, const Text& type) {
+            if (_count >= HC_FORM_PARTS) return nullptr;
+            _head(name, filename, type);
+            Part* part = &_parts[_count++];
+            *part = Part();
+            part->at = s.length();
+            _tail();
+            return part;
+        }
+
+        bool _done() {
+            return _end == 2;
+        }
+
+        // отправить следующую порцию тела не больше size байт, используя буфер buf. Вернёт количество отправленных
+        size_t _printNext(Print& p, uint8_t* buf, size_t size) {
+            _started = true;
+            while (1) {
+                if (_inPart) {
+                    if (_writer.left()) return _writer.printNext(p, buf, size);
+                    _inPart = false;
+                    _seg++;
+                }
+                size_t end = (_seg < _count) ? _parts[_seg].at : s.length();
+                if (_pos < end) {
+                    size_t len = p.write((const uint8_t*)s.c_str() + _pos, min(size, end - _pos));
+                    _pos += len;
+                    return len;
+                }
+                if (_seg < _count) {
+                    Part& part = _parts[_seg];
+                    _writer = part.stream ? StreamWriter(part.stream, part.len) : StreamWriter(part.buf, part.len, part.pgm);
+                    _inPart = true;
+                    continue;
+                }
+                if (_end < 2) {
+                    size_t len = p.write((const uint8_t*)"--" + _end, min(size, (size_t)(2 - _end)));
+                    _end += len;
+                    return len;
+                }
+                return 0;
+            }
+        }
+
+        // отправить тело целиком. Если поток части временно пуст - ждать данных до tout мс с последней отправки
+        bool _printTo(Print& p, uint16_t tout) {
+            PoolBlock block(GHTTP_POOL_BLOCK_SIZE);
+            if (!block) return false;
+            uint32_t ms = millis();
+            while (!_done()) {
+                GHTTP_ESP_YIELD();
+                if (_printNext(p, block.buf(), block.size())) ms = millis();
+                else if (millis() - ms >= tout) return false;
+                else delay(1);
+            }
+            return true;
         }
     };
 
@@ -85,11 +276,13 @@ class Client : public Print {
 
     // парсер ответа
     class Response {
+        friend class Client;
+
        public:
         Response() {}
-        Response(const String& type, Stream* stream, size_t len, bool chunked, uint16_t code) : _type(type), _reader(stream, len, chunked), _code(code) {}
+        Response(const Text& type, Stream* stream, size_t len, bool chunked, uint16_t code) : _type(type), _reader(stream, len, chunked), _code(code) {}
 
-        // тип контента
+        // тип контента. Действителен до следующего запроса
         Text type() const {
             return _type;
         }
@@ -106,22 +299,86 @@ class Client : public Print {
 
         // ответ существует
         operator bool() {
-            return _reader;
+            return _code || _reader;
+        }
+
+        // асинхронный режим: смещение текущей порции тела от начала
+        size_t index() {
+            return _index;
+        }
+
+        // асинхронный режим: последняя порция тела, запрос завершён
+        bool final() {
+            return _final;
+        }
+
+        // асинхронный режим: ошибка запроса
+        Error error() {
+            return _error;
         }
 
        private:
-        String _type;
+        Text _type;
         StreamReader _reader;
-        uint16_t _code;
+        uint16_t _code = 0;
+        size_t _index = 0;
+        bool _final = false;
+        Error _error = Error::None;
     };
 
    private:
 #ifdef __AVR__
     typedef void (*ResponseCallback)(Response& resp);
+    typedef void (*BodyCallback)(Response& resp, const uint8_t* data, size_t len);
 #else
     typedef std::function<void(Response& resp)> ResponseCallback;
+    typedef std::function<void(Response& resp, const uint8_t* data, size_t len)> BodyCallback;
 #endif
 
+    enum class State : uint8_t {
+        Headers,
+        Body,
+    };
+
+    enum class Chunk : uint8_t {
+        Size,
+        SizeEnd,
+        Data,
+        DataEnd,
+        Trailer,
+    };
+
+    class WritableString : public String {
+       public:
+        bool add(const uint8_t* data, size_t len) {
+            return concat((const char*)data, len);
+        }
+    };
+
+    // запрос в очереди. Хранится до получения ответа для повторной отправки, если сервер закрыл соединение
+    struct Entry {
+        String req;
+        BodyCallback cb = nullptr;
+        FormData* form = nullptr;
+        bool head = false;
+        bool upload = false;  // тело отправлено через beginUpload, повторить нельзя
+        GHTTP_METRIC(uint32_t queued = 0;)  // поставлен в очередь, micros
+    };
+
+    // вывод распакованного тела в обработчик асинхронного режима
+    class BodyOutput {
+       public:
+        BodyOutput(Client* c) : _c(c) {}
+
+        size_t write(const uint8_t* data, size_t len) {
+            _c->_output(data, len);
+            return len;
+        }
+
+       private:
+        Client* _c;
+    };
+
    public:
     Client(::Client& client, const char* host, uint16_t port) : client(client), _host(host), _port(port) {
         setTimeout(HC_DEF_TIMEOUT);
@@ -129,8 +386,12 @@ class Client : public Print {
     Client(::Client& client, const IPAddress& ip, uint16_t port) : client(client), _host(nullptr), _ip(ip), _port(port) {
         setTimeout(HC_DEF_TIMEOUT);
     }
+    ~Client() {
+        delete _gz;
+    }
 
     size_t write(uint8_t data) {
+        if (_uploading) return _out.write(data);
         if (!client.connected()) {
             _init();
             return 0;
@@ -141,6 +402,7 @@ class Client : public Print {
         return client.write(data);
     }
     size_t write(const uint8_t* buffer, size_t size) {
+        if (_uploading) return _out.write(buffer, size);
         if (!client.connected()) {
             _init();
             return 0;
@@ -180,11 +442,47 @@ class Client : public Print {
         _timeout = tout;
     }
 
-    // обработчик ответов, требует вызова tick() в loop()
+    // обработчик ответов, требует вызова tick() в loop(). В асинхронном режиме вызывается после получения хэдеров,
+    // тело передаётся в onBody
     void onResponse(ResponseCallback cb) {
         _resp_cb = cb;
     }
 
+    // асинхронный режим: обработчик порций тела ответа. По завершении запроса вызывается с final() и len 0,
+    // в том числе при ошибке (error())
+    void onBody(BodyCallback cb) {
+        _body_cb = cb;
+    }
+
+    // асинхронный режим: request() только ставит запрос в очередь, подключение, отправка и приём ответа
+    // выполняются по шагам в tick() без ожидания
+    void setAsync(bool async) {
+        _async = async;
+    }
+
+    // запрашивать сжатие ответов (Accept-Encoding: gzip) и распаковывать тело gzip: в асинхронном режиме - перед onBody,
+    // в синхронном - в body().writeTo() и readString(). Буфер распаковки (окно GHTTP_GUNZIP_WINDOW) выделяется при первом сжатом ответе
+    void useGzip(bool use) {
+        _gzipUse = use;
+    }
+
+    // асинхронные запросы выполняются
+    bool busy() {
+        return _qlen;
+    }
+
+    // количество запросов в очереди асинхронного режима
+    uint8_t queued() {
+        return _qlen;
+    }
+
+#ifdef GHTTP_METRICS
+    // накопительные счётчики асинхронного режима. Длительность запроса - от постановки в очередь до конца ответа
+    const Metrics& metrics() const {
+        return _metrics;
+    }
+#endif
+
     // ==========================
 
     // подключиться
@@ -195,10 +493,9 @@ class Client : public Print {
         return client.connected();
     }
 
-    // отправить запрос
+    // отправить запрос. Тело FormData читается при отправке, в асинхронном режиме data должна существовать до завершения запроса
     bool request(const Text& path, const Text& method, const Text& headers, FormData& data) {
-        data.s += "--";
-        return request(path, method, headers, (uint8_t*)data.s.c_str(), data.s.length(), true);
+        return _request(nullptr, path, method, headers, nullptr, 0, &data);
     }
 
     // отправить запрос
@@ -208,29 +505,64 @@ class Client : public Print {
 
     // отправить запрос
     bool request(const Text& path, const Text& method = "GET", const Text& headers = Text(), const uint8_t* payload = nullptr, size_t length = 0, bool formdata = 0) {
-        if (!beginSend()) return 0;
+        return _request(nullptr, path, method, headers, payload, length, nullptr, formdata);
+    }
+
+    // асинхронный режим: поставить запрос в очередь со своим обработчиком тела ответа вместо onBody
+    bool request(BodyCallback cb, const Text& path, const Text& method = "GET", const Text& headers = Text(), const Text& payload = Text()) {
+        return _async && _request(cb, path, method, headers, (uint8_t*)payload.str(), payload.length());
+    }
+
+    // начать запрос с телом неизвестной длины (Transfer-Encoding: chunked). Тело выводится через print/write
+    // клиента, копится в буфере и отправляется блоками по HC_CHUNK_SIZE. Завершить endUpload()
+    bool beginUpload(const Text& path, const Text& method = "POST", const Text& headers = Text()) {
+        if (_uploading) return 0;
+        if (_async) {
+            if (busy()) return 0;
+            if (!client.connected()) {
+                if (!connect()) return 0;
+                _pipeline = _reused = false;
+                GHTTP_METRIC(_metrics.connections++;)
+            }
+            _next();
+        } else if (!beginSend()) return 0;
 
         String req;
-        req.reserve(50 + path.length() + headers.length());
-        method.addString(req);
-        req += ' ';
-        path.addString(req);
-        req += F(" HTTP/1.1\r\nHost: ");
-        if (_host) req += _host;
-        else req += _ip.toString();
-        req += F("\r\n");
-        headers.addString(req);
-        if (formdata) {
-            req += F("Content-Type: multipart/form-data; boundary=" HC_BOUNDARY "\r\n");
-        }
-        if (payload && length) {
-            req += F("Content-Length: ");
-            req += length;
-            req += F("\r\n");
+        req.reserve(80 + path.length() + headers.length());
+        _startLine(req, path, method, headers);
+        req += F("Transfer-Encoding: chunked\r\n\r\n");
+        if (client.print(req) != req.length()) return 0;
+        GHTTP_METRIC(if (_async) _metrics.bytesOut += req.length();)
+
+        size_t size = HC_CHUNK_SIZE;
+        _upbuf = BlockPool::take(size);
+        _out.begin(&client, _upbuf, size);
+        _out.setChunked(true);
+        _uploading = true;
+        return 1;
+    }
+
+    // завершить тело запроса beginUpload. Дальше - getResponse(), в асинхронном режиме ответ придёт в обработчики
+    bool endUpload(BodyCallback cb = nullptr) {
+        if (!_uploading) return 0;
+        _out.end();
+        GHTTP_METRIC(if (_async) _metrics.bytesOut += _out.sent;)
+        BlockPool::give(_upbuf);
+        _upbuf = nullptr;
+        _uploading = false;
+        if (!client.connected()) return 0;
+
+        if (_async) {
+            // запрос уже отправлен, в очереди только ожидание ответа
+            _tmr = millis();
+            Entry& e = _entry(_qlen++);
+            e.cb = cb;
+            e.upload = true;
+            GHTTP_METRIC(e.queued = micros();)
+            return 1;
         }
-        req += F("\r\n");
-        print(req);
-        if (payload && length) write(payload, length);
+        _waiting = 1;
+        _lastSend = millis();
         return 1;
     }
 
@@ -263,16 +595,19 @@ class Client : public Print {
             return Response();
         }
 
-        String lineStr = client.readStringUntil('\n');
-        Text lines[3];
-        Text(lineStr).split(lines, 3, ' ');
+        HeadersParser headers(_headers, HC_HEADERS_SIZE);
+        headers.read(client, collector);
 
-        HeadersParser headers(client, collector);
+        Text lines[3];
+        headers.startLine().split(lines, 3, ' ');
 
         if (headers) {
-            _close = headers.close;
+            uint16_t code = lines[1].toInt();
+            _close = _closes(headers, lines[0], code == 204 || code == 304);
             _waiting = 0;
-            return Response(headers.contentType, &client, headers.length, headers.chunked, lines[1].toInt());
+            Response resp(headers.contentType, &client, headers.length, headers.chunked, lines[1].toInt());
+            if (_gunzip(headers)) resp._reader.setGzip(_gz);
+            return resp;
         } else {
             flush();
             return Response();
@@ -280,29 +615,38 @@ class Client : public Print {
     }
 
     // тикер, вызывать в loop для работы с коллбэком
-    void tick() {
+    void tick(HeadersCollector* collector = nullptr) {
+        if (_async) return _tick(collector);
+
         if (available() && _resp_cb) {
-            Response resp = getResponse();
+            Response resp = getResponse(collector);
             if (resp) _resp_cb(resp);
         }
     }
 
-    // остановить клиента
+    // остановить клиента. Очередь асинхронного режима очищается без вызова обработчиков
     void stop() {
         HC_LOG("client stop");
-        client.stop();
-        _init();
+        if (_uploading) {
+            BlockPool::give(_upbuf);
+            _upbuf = nullptr;
+            _uploading = false;
+            _out.begin(nullptr, nullptr, 0);
+        }
+        _drop();
+        while (_qlen) _pop();
     }
 
     // пропустить ответ, снять флаг ожидания, остановить если connection close
     void flush() {
         if (client.connected()) {
             _wait();
-            uint8_t bytes[HC_FLUSH_BLOCK];
+            PoolBlock block(HC_FLUSH_BLOCK);
             while (client.available()) {
                 delay(1);
                 GHTTP_ESP_YIELD();
-                client.readBytes(bytes, min(client.available(), HC_FLUSH_BLOCK));
+                if (block) client.readBytes(block.buf(), min((size_t)client.available(), block.size()));
+                else client.read();
             }
             if (_close) {
                 HC_LOG("connection close");
@@ -316,13 +660,367 @@ class Client : public Print {
 
    private:
     ResponseCallback _resp_cb = nullptr;
+    BodyCallback _body_cb = nullptr;
     const char* _host = nullptr;
     IPAddress _ip;
     uint16_t _port;
     uint16_t _timeout;
     uint32_t _lastSend;
+    char _headers[HC_HEADERS_SIZE];
     bool _close = 0;
     bool _waiting = 0;
+    bool _gzipUse = 0;
+    GzipReader* _gz = nullptr;
+
+    // отправка тела неизвестной длины
+    OutputBuffer _out;
+    uint8_t* _upbuf = nullptr;
+    bool _uploading = 0;
+
+    // асинхронный режим
+    Entry _queue[HC_QUEUE_SIZE];
+    uint8_t _qfirst = 0;    // первый запрос очереди, ожидает ответа
+    uint8_t _qlen = 0;      // запросов в очереди
+    uint8_t _qsent = 0;     // отправлено запросов с начала очереди
+    size_t _sent = 0;       // отправлено байт следующего запроса
+    HeadersParser _parser;
+    Response _resp;
+    size_t _left = 0;
+    uint32_t _tmr = 0;
+    uint8_t _line = 0;
+    State _state = State::Headers;
+    Chunk _chunk = Chunk::Size;
+    bool _async = 0;
+    bool _chunked = 0;
+    bool _untilClose = 0;
+    bool _pipeline = 0;     // сервер держит соединение, запросы отправляются конвейером
+    bool _reused = 0;       // на подключении уже получен ответ
+    bool _inflate = 0;      // тело ответа распаковывается
+    GHTTP_METRIC(Metrics _metrics;)
+
+    void _tick(HeadersCollector* collector) {
+        if (!_qlen) return;
+        if (!_qsent && !_sent && !client.connected()) {
+            if (_entry(0).upload) return _finish(Error::Disconnect);
+            // подключение выполняет ::Client, на большинстве платформ оно блокирующее
+            if (!connect()) return _finish(Error::Connect);
+            _pipeline = _reused = false;
+            GHTTP_METRIC(_metrics.connections++;)
+            _next();
+            _tmr = millis();
+        }
+
+        _send();
+        if (_qsent) {
+            if (_state == State::Headers) _readHeaders(collector);
+            else _readBody();
+        }
+        if (_qlen && millis() - _tmr >= _timeout) {
+            HC_LOG("client timeout");
+            _finish(Error::Timeout);
+        }
+    }
+
+    // отправить запросы очереди. Первый запрос на подключении отправляется один, следующие - сразу за ним,
+    // если сервер держит соединение, иначе по одному после получения ответа. За шаг - одна запись
+    void _send() {
+        if (!_qsent && _sent && !client.connected()) {
+            // сервер закрыл неактивное keep-alive подключение во время отправки - запрос будет отправлен заново
+            if (_reused && _replay(_entry(0))) return _drop();
+            return _finish(Error::Disconnect);
+        }
+        while (_qsent < _qlen && (!_qsent || _pipeline)) {
+            Entry& e = _entry(_qsent);
+            if (e.form && _qsent) return;  // FormData нельзя отправить повторно, поэтому не идёт в конвейере
+            if (_sent >= e.req.length() && (!e.form || e.form->_done())) {
+                _sent = 0;
+                _qsent++;
+                continue;
+            }
+
+            int avail = client.availableForWrite();
+#if defined(ESP8266) || defined(ESP32)
+            if (avail <= 0) return;  // буфер отправки занят
+#else
+            if (avail <= 0) avail = GHTTP_TCP_MSS;
+#endif
+            size_t len = 0;
+            if (_sent < e.req.length()) {
+                len = client.write((const uint8_t*)e.req.c_str() + _sent, min(e.req.length() - _sent, (size_t)avail));
+                _sent += len;
+            } else {
+                PoolBlock block(avail);
+                if (block) len = e.form->_printNext(client, block.buf(), block.size());
+            }
+            if (len) _tmr = millis();
+            GHTTP_METRIC(_metrics.bytesOut += len;)
+            return;
+        }
+    }
+
+    void _readHeaders(HeadersCollector* collector) {
+        if (client.available()) {
+            _tmr = millis();
+        } else if (!client.connected()) {
+            // сервер закрыл неактивное keep-alive подключение до ответа - запросы будут отправлены заново
+            if (_reused && _parser.empty() && _replay(_entry(0))) return _drop();
+            return _finish(Error::Disconnect);
+        }
+        if (_parser.parse(client, collector)) _begin();
+    }
+
+    // хэдеры ответа получены
+    void _begin() {
+        GHTTP_METRIC(_metrics.bytesIn += _parser.received;)
+        if (!_parser) return _finish(Error::Parse);
+
+        Text lines[3];
+        _parser.startLine().split(lines, 3, ' ');
+        uint16_t code = lines[1].toInt();
+        if (code < 200 && code >= 100) {  // информационный ответ, ждём основной
+            _parser = HeadersParser(_headers, HC_HEADERS_SIZE);
+            return;
+        }
+
+        bool nobody = _entry(0).head || code == 204 || code == 304;
+        _resp = Response(_parser.contentType, nullptr, 0, false, code);
+        _close = _closes(_parser, lines[0], nobody);
+        _pipeline = !_close && lines[0] == "HTTP/1.1";
+        _chunked = !nobody && _parser.chunked;
+        _left = (nobody || _chunked) ? 0 : _parser.length;
+        _untilClose = !nobody && !_chunked && !_parser.hasLength;
+        _inflate = (_chunked || _left || _untilClose) && _gunzip(_parser);
+        if (_inflate) _gz->begin();
+        _chunk = Chunk::Size;
+        _line = 0;
+        _state = State::Body;
+        if (_resp_cb) _resp_cb(_resp);
+    }
+
+    // принять доступную часть тела
+    void _readBody() {
+        if (!_chunked) {
+            if (!_untilClose && !_left) return _finish(Error::None);
+            size_t avail = client.available();
+            if (avail) _readData(_untilClose ? avail : min(avail, _left));
+            else if (!client.connected()) _finish(_untilClose ? Error::None : Error::Disconnect);
+            return;
+        }
+
+        while (_state == State::Body) {
+            size_t avail = client.available();
+            if (!avail) {
+                if (!client.connected()) _finish(Error::Disconnect);
+                return;
+            }
+            _tmr = millis();
+            if (_chunk == Chunk::Data) {
+                _readData(min(avail, _left));
+                if (!_left) _chunk = Chunk::DataEnd;
+                return;
+            }
+
+            int c = client.read();
+            GHTTP_METRIC(_metrics.bytesIn++;)
+            switch (_chunk) {
+                case Chunk::Size:
+                    if (isxdigit(c)) {
+                        if (++_line > sizeof(size_t) * 2) return _finish(Error::Parse);
+                        _left = (_left << 4) | (c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+                        break;
+                    }
+                    if (!_line) return _finish(Error::Parse);
+                    _chunk = Chunk::SizeEnd;
+                    // fall through
+
+                case Chunk::SizeEnd:  // расширения chunk не используются
+                    if (c == '\n') {
+                        _line = 0;
+                        _chunk = _left ? Chunk::Data : Chunk::Trailer;
+                    }
+                    break;
+
+                case Chunk::DataEnd:
+                    if (c == '\n') _chunk = Chunk::Size;
+                    else if (c != '\r') return _finish(Error::Parse);
+                    break;
+
+                case Chunk::Trailer:  // трейлеры пропускаются до пустой строки
+                    if (c == '\n') {
+                        if (!_line) return _finish(Error::None);
+                        _line = 0;
+                    } else if (c != '\r' && _line < 255) {
+                        _line++;
+                    }
+                    break;
+
+                default:
+                    break;
+            }
+        }
+    }
+
+    void _readData(size_t len) {
+        PoolBlock block(len);
+        if (!block) return;
+        int read = client.read(block.buf(), block.size());
+        if (read <= 0) return;
+        _tmr = millis();
+        GHTTP_METRIC(_metrics.bytesIn += read;)
+        if (!_untilClose) _left -= read;
+        if (!_inflate) return _output(block.buf(), read);
+
+        BodyOutput out(this);
+        if (!_gz->decode(block.buf(), read, out)) _finish(Error::Parse);
+    }
+
+    // ответ сжат gzip и будет распакован
+    bool _gunzip(const HeadersParser& headers) {
+        return headers.gzip && _gzipUse && (_gz || (_gz = new GzipReader()));
+    }
+
+    void _output(const uint8_t* data, size_t len) {
+        BodyCallback& cb = _entry(0).cb ? _entry(0).cb : _body_cb;
+        if (cb) cb(_resp, data, len);
+        _resp._index += len;
+    }
+
+    // завершить первый запрос очереди
+    void _finish(Error error) {
+        if (error == Error::None && _inflate && !_gz->done()) error = Error::Parse;  // поток gzip оборван
+        _inflate = false;
+        if (error != Error::None) {
+            HC_LOG("client error");
+        }
+        GHTTP_METRIC(_metricsFinish(error);)
+        BodyCallback cb = _entry(0).cb ? _entry(0).cb : _body_cb;
+        _pop();
+        _tmr = millis();
+        if (_close || error != Error::None) {
+            // отправленные следом запросы сервер не обработает, они будут отправлены на новом подключении
+            _drop();
+        } else {
+            _qsent--;
+            _reused = true;
+            _init();
+        }
+
+        _resp._error = error;
+        _resp._final = true;
+        if (cb) cb(_resp, nullptr, 0);
+        _next();
+    }
+
+#ifdef GHTTP_METRICS
+    // учесть завершение первого запроса очереди
+    void _metricsFinish(Error error) {
+        switch (error) {
+            case Error::None: break;
+            case Error::Timeout: _metrics.timeouts++; break;
+            case Error::Parse: _metrics.parseErrors++; break;
+            default: _metrics.errors++; break;
+        }
+        _metrics.count(error == Error::None ? _resp._code : 0, micros() - _entry(0).queued);
+    }
+#endif
+
+    // ожидать ответ на следующий запрос
+    void _next() {
+        _parser = HeadersParser(_headers, HC_HEADERS_SIZE);
+        _resp = Response();
+        _state = State::Headers;
+    }
+
+    // разорвать подключение, неотвеченные запросы остаются в очереди
+    void _drop() {
+        client.stop();
+        _init();
+        _qsent = 0;
+        _sent = 0;
+    }
+
+    // запрос можно отправить заново
+    static bool _replay(Entry& e) {
+        return !e.upload && (!e.form || e.form->rewind());
+    }
+
+    Entry& _entry(uint8_t i) {
+        return _queue[(_qfirst + i) % HC_QUEUE_SIZE];
+    }
+
+    void _pop() {
+        Entry& e = _entry(0);
+        e.req = String();
+        e.cb = nullptr;
+        e.form = nullptr;
+        e.upload = false;
+        _qfirst = (_qfirst + 1) % HC_QUEUE_SIZE;
+        _qlen--;
+    }
+
+    bool _request(BodyCallback cb, const Text& path, const Text& method, const Text& headers, const uint8_t* payload, size_t length, FormData* form = nullptr, bool formdata = 0) {
+        if (form) {
+            if (!form->rewind()) return 0;
+            payload = nullptr;
+            length = form->length();
+            formdata = true;
+        } else if (!payload) {
+            length = 0;
+        }
+        if (_uploading) return 0;
+        if (_async) {
+            if (_qlen >= HC_QUEUE_SIZE) return 0;
+        } else if (!beginSend()) return 0;
+
+        WritableString req;
+        req.reserve(50 + path.length() + headers.length() + (_async && payload ? length : 0));
+        _startLine(req, path, method, headers);
+        if (formdata) {
+            req += F("Content-Type: multipart/form-data; boundary=" HC_BOUNDARY "\r\n");
+        }
+        if (length) {
+            req += F("Content-Length: ");
+            req += length;
+            req += F("\r\n");
+        }
+        req += F("\r\n");
+
+        if (_async) {
+            if (payload && length && !req.add(payload, length)) return 0;
+            if (!_qlen) _tmr = millis();
+            Entry& e = _entry(_qlen++);
+            e.req = req;
+            e.cb = cb;
+            e.form = form;
+            e.head = (method == "HEAD");
+            GHTTP_METRIC(e.queued = micros();)
+            return 1;
+        }
+        print(req);
+        if (payload && length) write(payload, length);
+        if (form) return form->_printTo(*this, _timeout);
+        return 1;
+    }
+
+    // стартовая строка, Host и хэдеры пользователя
+    void _startLine(String& req, const Text& path, const Text& method, const Text& headers) {
+        method.addString(req);
+        req += ' ';
+        path.addString(req);
+        req += F(" HTTP/1.1\r\nHost: ");
+        if (_host) req += _host;
+        else req += _ip.toString();
+        req += F("\r\n");
+        if (_gzipUse) req += F("Accept-Encoding: gzip\r\n");
+        headers.addString(req);
+    }
+
+    // подключение закрывается после ответа: явно, HTTP/1.0 без keep-alive или тело без длины читается до закрытия.
+    // nobody - у ответа нет тела (HEAD, 204, 304)
+    static bool _closes(const HeadersParser& headers, const Text& version, bool nobody) {
+        if (headers.close || (!(version == "HTTP/1.1") && !headers.keepAlive)) return true;
+        return !nobody && !headers.chunked && !headers.hasLength;
+    }
 
     void _init() {
         _close = 0;
@@ -0,0 +1,127 @@
+#pragma once
+#include <Arduino.h>
+
+#include "Client.h"
+
+#ifndef HC_POOL_SIZE
+#ifdef __AVR__
+#define HC_POOL_SIZE 1              // количество подключений в пуле
+#else
+#define HC_POOL_SIZE 3              // количество подключений в пуле
+#endif
+#endif
+
+#ifndef HC_POOL_IDLE_TOUT
+#define HC_POOL_IDLE_TOUT 10000     // закрыть подключение пула после бездействия, мс
+#endif
+
+namespace ghttp {
+
+// пул HTTP клиентов к разным хостам. Каждый слот владеет своим подключением и хранит его между запросами,
+// повторный запрос к тому же хосту идёт по открытому keep-alive подключению без нового подключения и TLS рукопожатия
+template <typename client_t, uint8_t size = HC_POOL_SIZE>
+class ClientPool {
+   public:
+    // получить клиента для host:port. Строка хоста должна существовать всё время использования.
+    // Подключение к тому же хосту используется повторно, иначе занимается свободный слот или вытесняется
+    // давно не использованный (LRU). nullptr - все клиенты выполняют запросы
+    Client* get(const char* host, uint16_t port) {
+        return _get(host, IPAddress(), port);
+    }
+
+    // получить клиента для ip:port
+    Client* get(const IPAddress& ip, uint16_t port) {
+        return _get(nullptr, ip, port);
+    }
+
+    // установить таймаут бездействия подключения, умолч. HC_POOL_IDLE_TOUT
+    void setIdleTimeout(uint32_t tout) {
+        _idleTout = tout;
+    }
+
+    // асинхронный режим для всех клиентов пула
+    void setAsync(bool async) {
+        for (Slot& slot : _slots) slot.http.setAsync(async);
+    }
+
+    // сокет слота для настройки (например setInsecure)
+    client_t& socket(uint8_t i) {
+        return _slots[i].socket;
+    }
+
+    // количество открытых подключений
+    uint8_t connected() {
+        uint8_t n = 0;
+        for (Slot& slot : _slots) n += slot.socket.connected() ? 1 : 0;
+        return n;
+    }
+
+    // закрыть все подключения
+    void stop() {
+        for (Slot& slot : _slots) slot.http.stop();
+    }
+
+    // вызывать в loop. Тикает клиентов и закрывает подключения, бездействующие дольше таймаута
+    void tick(HeadersCollector* collector = nullptr) {
+        for (Slot& slot : _slots) {
+            if (!slot.port) continue;
+            slot.http.tick(collector);
+            if (_busy(slot)) {
+                slot.used = millis();
+            } else if (slot.socket.connected() && millis() - slot.used >= _idleTout) {
+                HC_LOG("pool idle close");
+                slot.http.stop();
+            }
+        }
+    }
+
+   private:
+    struct Slot {
+        Slot() : http(socket, (const char*)nullptr, 0) {}
+
+        client_t socket;
+        Client http;
+        const char* host = nullptr;
+        IPAddress ip;
+        uint16_t port = 0;
+        uint32_t used = 0;
+    };
+
+    Slot _slots[size];
+    uint32_t _idleTout = HC_POOL_IDLE_TOUT;
+
+    Client* _get(const char* host, const IPAddress& ip, uint16_t port) {
+        Slot* free = nullptr;
+        Slot* lru = nullptr;
+        for (Slot& slot : _slots) {
+            if (slot.port == port && (host ? (slot.host && !strcmp(slot.host, host)) : (!slot.host && slot.ip == ip))) {
+                slot.used = millis();
+                return &slot.http;
+            }
+            if (_busy(slot)) continue;
+            if (!slot.socket.connected()) {
+                if (!free) free = &slot;
+            } else if (!lru || (millis() - slot.used) > (millis() - lru->used)) {
+                lru = &slot;
+            }
+        }
+
+        // сначала слот без подключения, затем вытесняется давно не использованное подключение
+        if (!free) free = lru;
+        if (!free) return nullptr;
+
+        if (host) free->http.setHost(host, port);
+        else free->http.setHost(ip, port);
+        free->host = host;
+        free->ip = ip;
+        free->port = port;
+        free->used = millis();
+        return &free->http;
+    }
+
+    static bool _busy(Slot& slot) {
+        return slot.http.busy() || slot.http.isWaiting();
+    }
+};
+
+}  // namespace ghttp
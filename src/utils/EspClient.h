@@ -4,6 +4,7 @@
 #if defined(ESP8266) || defined(ESP32)
 
 #include "Client.h"
+#include "ClientPool.h"
 
 #if defined(ESP8266)
 #include <ESP8266WiFi.h>
@@ -33,5 +34,17 @@ class EspInsecureClient : public ghttp::Client {
 #endif
 };
 
+template <uint8_t size = HC_POOL_SIZE>
+#if defined(ESP8266)
+class EspInsecurePool : public ghttp::ClientPool<BearSSL::WiFiClientSecure, size> {
+#else
+class EspInsecurePool : public ghttp::ClientPool<WiFiClientSecure, size> {
+#endif
+   public:
+    EspInsecurePool() {
+        for (uint8_t i = 0; i < size; i++) this->socket(i).setInsecure();
+    }
+};
+
 }  // namespace ghttp
 #endif
\ No newline at end of file
@@ -0,0 +1,171 @@
+#pragma once
+#include <Arduino.h>
+#include <StringUtils.h>
+
+#include "cfg.h"
+
+#ifndef HS_EVENTS_BUFFER
+#ifdef __AVR__
+#define HS_EVENTS_BUFFER 128    // очередь событий Server-Sent Events, байт
+#else
+#define HS_EVENTS_BUFFER 2048   // очередь событий Server-Sent Events, байт
+#endif
+#endif
+
+#ifndef HS_EVENTS_QUEUE
+#ifdef __AVR__
+#define HS_EVENTS_QUEUE 2       // макс. событий в очереди
+#else
+#define HS_EVENTS_QUEUE 16      // макс. событий в очереди
+#endif
+#endif
+
+namespace ghttp {
+
+// общая очередь событий text/event-stream. Событие сериализуется один раз, подписчики читают его со своей позиции.
+// Позиция - номер байта от начала потока, старые события вытесняются новыми при заполнении очереди
+class EventQueue {
+   public:
+    // что делать с подписчиком, который отстал и чьи события вытеснены из очереди
+    enum class Drop : uint8_t {
+        Skip,   // пропустить вытесненные события, продолжить с самого старого в очереди
+        Close,  // закрыть подключение
+    };
+
+    // добавить событие. Многострочные данные разбиваются на строки data. Вернёт false, если событие больше очереди
+    bool add(const Text& data, const Text& event = Text(), const Text& id = Text()) {
+        Counter count;
+        _print(count, data, event, id);
+        if (!_reserve(count.len)) return false;
+        Writer w(*this);
+        _print(w, data, event, id);
+        return true;
+    }
+
+    // добавить готовое сообщение из заголовка head и данных data (кадр WebSocket). Вернёт false, если оно больше очереди
+    bool add(const uint8_t* head, uint8_t hlen, const uint8_t* data, size_t len) {
+        if (!_reserve(hlen + len)) return false;
+        Writer w(*this);
+        w.write(head, hlen);
+        w.write(data, len);
+        return true;
+    }
+
+    // позиция конца очереди - сюда будет записано следующее событие
+    uint32_t end() const {
+        return _end;
+    }
+
+    // позиция начала самого старого события в очереди
+    uint32_t first() const {
+        return _count ? _starts[_first] : _end;
+    }
+
+    // данные с позиции вытеснены из очереди
+    bool lost(uint32_t pos) const {
+        return pos - first() > _end - first();
+    }
+
+    // позиция внутри события (событие отправлено не полностью)
+    bool partial(uint32_t pos) const {
+        if (pos == _end) return false;
+        for (uint8_t i = 0; i < _count; i++) {
+            if (_starts[(_first + i) % HS_EVENTS_QUEUE] == pos) return false;
+        }
+        return true;
+    }
+
+    // вывести данные с позиции pos не больше len байт, pos сдвигается на отправленные. partial - можно вывести событие
+    // частично, иначе выводятся только целые события. Вернёт количество отправленных
+    size_t printTo(Print& p, uint32_t& pos, size_t len, bool partial = true) {
+        if (!partial) len = _fit(pos, len);
+        size_t sent = 0;
+        while (len && pos != _end) {
+            uint16_t from = pos % HS_EVENTS_BUFFER;
+            size_t n = min(min(len, (size_t)(_end - pos)), (size_t)(HS_EVENTS_BUFFER - from));
+            size_t w = p.write(_buf + from, n);
+            pos += w;
+            sent += w;
+            len -= w;
+            if (w != n) break;
+        }
+        return sent;
+    }
+
+   private:
+    class Counter : public Print {
+       public:
+        size_t write(uint8_t) {
+            len++;
+            return 1;
+        }
+        size_t len = 0;
+    };
+
+    class Writer : public Print {
+       public:
+        Writer(EventQueue& q) : _q(q) {}
+
+        using Print::write;
+        size_t write(uint8_t data) {
+            _q._buf[_q._end++ % HS_EVENTS_BUFFER] = data;
+            return 1;
+        }
+
+       private:
+        EventQueue& _q;
+    };
+
+    uint8_t _buf[HS_EVENTS_BUFFER];
+    uint32_t _starts[HS_EVENTS_QUEUE];
+    uint32_t _end = 0;
+    uint8_t _first = 0;
+    uint8_t _count = 0;
+
+    // начать событие длины len, вытеснив старые. Вернёт false, если событие больше очереди
+    bool _reserve(size_t len) {
+        if (len > HS_EVENTS_BUFFER) return false;
+        while (_count && (_count == HS_EVENTS_QUEUE || _end + len - first() > HS_EVENTS_BUFFER)) {
+            _first = (_first + 1) % HS_EVENTS_QUEUE;
+            _count--;
+        }
+        _starts[(_first + _count) % HS_EVENTS_QUEUE] = _end;
+        _count++;
+        return true;
+    }
+
+    // байт от позиции до конца последнего события, целиком помещающегося в len
+    size_t _fit(uint32_t pos, size_t len) const {
+        size_t fit = 0;
+        for (uint8_t i = 0; i <= _count; i++) {
+            uint32_t to = (i < _count) ? _starts[(_first + i) % HS_EVENTS_QUEUE] : _end;
+            if (to - pos > _end - pos) continue;  // до позиции
+            if (to - pos > len) break;
+            fit = to - pos;
+        }
+        return fit;
+    }
+
+    static void _print(Print& p, const Text& data, const Text& event, const Text& id) {
+        if (event.length()) _field(p, F("event: "), event);
+        if (id.length()) _field(p, F("id: "), id);
+        int16_t from = 0;
+        do {
+            int16_t to = data.indexOf('\n', from);
+            if (to < 0) to = data.length();
+            uint16_t len = to - from;
+            if (len && data[from + len - 1] == '\r') len--;
+            _field(p, F("data: "), Text(data.str() + from, len, data.pgm()));
+            from = to + 1;
+        } while (from <= (int16_t)data.length());
+        p.print('\n');
+    }
+
+    static void _field(Print& p, const __FlashStringHelper* name, const Text& value) {
+        p.print(name);
+        p.print(value);
+        p.print('\n');
+    }
+};
+
+}  // namespace ghttp
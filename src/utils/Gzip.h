@@ -0,0 +1,624 @@
+#pragma once
+#include <Arduino.h>
+
+#include "cfg.h"
+
+#ifndef GHTTP_GZIP_WINDOW
+#define GHTTP_GZIP_WINDOW 1024      // окно поиска совпадений сжатия, степень 2 от 512 до 16384. Память: 4 окна + хэш-таблица
+#endif
+
+#ifndef GHTTP_GZIP_CHAIN
+#define GHTTP_GZIP_CHAIN 4          // проверять совпадений с одним хэшем: больше - лучше сжатие и медленнее
+#endif
+
+#ifndef GHTTP_GZIP_HASH
+#define GHTTP_GZIP_HASH 10          // размер хэш-таблицы сжатия, бит (2 байта на ячейку)
+#endif
+
+#ifndef GHTTP_GUNZIP_WINDOW
+#define GHTTP_GUNZIP_WINDOW 32768   // окно распаковки, степень 2 от 256 до 32768. Меньше 32 кБ - только если сервер сжимает с таким окном или ответ меньше окна
+#endif
+
+namespace ghttp {
+
+// таблицы deflate (RFC 1951): основание и дополнительные биты кодов длины 257..285 и расстояния 0..29
+struct Deflate {
+    static const uint16_t MIN_MATCH = 3;
+    static const uint16_t MAX_MATCH = 258;
+
+    static uint16_t lengthBase(uint8_t i) {
+        static const uint16_t t[] PROGMEM = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        return pgm_read_word(t + i);
+    }
+    static uint8_t lengthExtra(uint8_t i) {
+        return (i < 8 || i == 28) ? 0 : (i - 4) / 4;
+    }
+    static uint16_t distBase(uint8_t i) {
+        static const uint16_t t[] PROGMEM = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+        return pgm_read_word(t + i);
+    }
+    static uint8_t distExtra(uint8_t i) {
+        return i < 4 ? 0 : (i - 2) / 2;
+    }
+
+    // CRC32 gzip, таблица по 4 бита
+    static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t len) {
+        static const uint32_t t[] PROGMEM = {
+            0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+            0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c};
+        crc = ~crc;
+        while (len--) {
+            crc ^= *data++;
+            crc = (crc >> 4) ^ pgm_read_dword(t + (crc & 15));
+            crc = (crc >> 4) ^ pgm_read_dword(t + (crc & 15));
+        }
+        return ~crc;
+    }
+};
+
+// потоковое сжатие gzip: LZ77 с цепочками хэшей в окне GHTTP_GZIP_WINDOW и фиксированные коды Хаффмана (deflate, блоки типа 1).
+// Данные пишутся через Print, сжатые уходят в вывод при заполнении буфера и в end(). Память не выделяется
+class GzipWriter : public Print {
+    static const uint16_t WINDOW = GHTTP_GZIP_WINDOW;
+    static_assert(WINDOW >= 512 && WINDOW <= 16384 && !(WINDOW & (WINDOW - 1)), "GHTTP_GZIP_WINDOW: power of 2 in 512..16384");
+
+   public:
+    // начать поток в p: заголовок gzip и начало блока
+    void begin(Print* p) {
+        _p = p;
+        _len = _pos = 0;
+        _bits = 0;
+        _nbits = 0;
+        _olen = 0;
+        _crc = 0;
+        _size = 0;
+        memset(_head, 0, sizeof(_head));
+        memset(_prev, 0, sizeof(_prev));
+        static const uint8_t header[] PROGMEM = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff};
+        for (uint8_t i = 0; i < sizeof(header); i++) _byte(pgm_read_byte(header + i));
+        _put(0, 1);  // не последний блок
+        _put(1, 2);  // фиксированные коды
+    }
+
+    // поток открыт
+    bool active() const {
+        return _p;
+    }
+
+    using Print::write;
+    size_t write(uint8_t data) {
+        return write(&data, 1);
+    }
+    size_t write(const uint8_t* data, size_t len) {
+        if (!_p) return 0;
+        _crc = Deflate::crc32(_crc, data, len);
+        _size += len;
+        for (size_t left = len; left;) {
+            if (_len == sizeof(_buf)) {
+                _compress(false);
+                _slide();
+            }
+            size_t n = min(left, sizeof(_buf) - _len);
+            memcpy(_buf + _len, data, n);
+            _len += n;
+            data += n;
+            left -= n;
+        }
+        return len;
+    }
+
+    // сжать остаток и завершить поток: конец блока, пустой последний блок, CRC32 и размер
+    void end() {
+        if (!_p) return;
+        _compress(true);
+        _symbol(256);
+        _put(1, 1);
+        _put(1, 2);
+        _symbol(256);
+        if (_nbits) _put(0, 8 - _nbits);
+        for (uint8_t i = 0; i < 4; i++) _byte(_crc >> (i * 8));
+        for (uint8_t i = 0; i < 4; i++) _byte(_size >> (i * 8));
+        _flush();
+        _p = nullptr;
+    }
+
+   private:
+    Print* _p = nullptr;
+    uint8_t _buf[WINDOW * 2];               // окно и новые данные
+    uint16_t _head[1 << GHTTP_GZIP_HASH];   // последняя позиция + 1 с таким хэшем, 0 - нет
+    uint16_t _prev[WINDOW];                 // предыдущая позиция + 1 с тем же хэшем, по позиции в окне
+    uint16_t _len = 0;
+    uint16_t _pos = 0;                      // первый несжатый байт
+    uint32_t _bits = 0;
+    uint8_t _nbits = 0;
+    uint8_t _out[32];
+    uint8_t _olen = 0;
+    uint32_t _crc = 0;
+    uint32_t _size = 0;
+
+    static uint16_t _hash(const uint8_t* p) {
+        return ((p[0] << 10) ^ (p[1] << 5) ^ p[2]) & ((1 << GHTTP_GZIP_HASH) - 1);
+    }
+
+    // добавить позицию в цепочку её хэша. Вернёт предыдущую позицию + 1 с тем же хэшем
+    uint16_t _insert(uint16_t pos) {
+        uint16_t h = _hash(_buf + pos);
+        uint16_t from = _head[h];
+        _prev[pos & (WINDOW - 1)] = from;
+        _head[h] = pos + 1;
+        return from;
+    }
+
+    // сжать накопленные данные. Без flush остаётся запас MAX_MATCH для поиска совпадений со следующими данными
+    void _compress(bool flush) {
+        while (_pos < _len && (flush || _len - _pos >= Deflate::MAX_MATCH)) {
+            uint16_t len = 0;
+            uint16_t dist = 0;
+            if (_len - _pos >= Deflate::MIN_MATCH) {
+                uint16_t from = _insert(_pos);
+                uint16_t max = min(_len - _pos, (int)Deflate::MAX_MATCH);
+                const uint8_t* b = _buf + _pos;
+                for (uint8_t chain = GHTTP_GZIP_CHAIN; chain && from && _pos - (from - 1) <= WINDOW; chain--) {
+                    const uint8_t* a = _buf + from - 1;
+                    if (a[len] == b[len]) {  // короче найденного - не проверяется
+                        uint16_t l = 0;
+                        while (l < max && a[l] == b[l]) l++;
+                        if (l > len) {
+                            len = l;
+                            dist = b - a;
+                            if (len == max) break;
+                        }
+                    }
+                    uint16_t next = _prev[(from - 1) & (WINDOW - 1)];
+                    if (next >= from) break;  // позиция в кольце уже перезаписана
+                    from = next;
+                }
+            }
+            if (len >= Deflate::MIN_MATCH) {
+                _match(len, dist);
+                for (uint16_t i = 1; i < len && _pos + i + Deflate::MIN_MATCH <= _len; i++) _insert(_pos + i);
+                _pos += len;
+            } else {
+                _symbol(_buf[_pos++]);
+            }
+        }
+    }
+
+    // сдвинуть буфер на окно: сжатые данные старше окна больше не нужны
+    void _slide() {
+        memmove(_buf, _buf + WINDOW, _len - WINDOW);
+        _len -= WINDOW;
+        _pos -= WINDOW;
+        for (uint16_t& h : _head) h = (h > WINDOW) ? h - WINDOW : 0;
+        for (uint16_t& h : _prev) h = (h > WINDOW) ? h - WINDOW : 0;
+    }
+
+    void _match(uint16_t len, uint16_t dist) {
+        uint8_t i = 28;
+        while (Deflate::lengthBase(i) > len) i--;
+        _symbol(257 + i);
+        _put(len - Deflate::lengthBase(i), Deflate::lengthExtra(i));
+
+        i = 29;
+        while (Deflate::distBase(i) > dist) i--;
+        _code(i, 5);
+        _put(dist - Deflate::distBase(i), Deflate::distExtra(i));
+    }
+
+    // символ фиксированным кодом Хаффмана
+    void _symbol(uint16_t s) {
+        if (s < 144) _code(0x30 + s, 8);
+        else if (s < 256) _code(0x190 + s - 144, 9);
+        else if (s < 280) _code(s - 256, 7);
+        else _code(0xc0 + s - 280, 8);
+    }
+
+    // код Хаффмана пишется со старшего бита
+    void _code(uint16_t code, uint8_t len) {
+        uint16_t rev = 0;
+        for (uint8_t i = 0; i < len; i++) {
+            rev = (rev << 1) | (code & 1);
+            code >>= 1;
+        }
+        _put(rev, len);
+    }
+
+    // биты со младшего
+    void _put(uint32_t value, uint8_t len) {
+        _bits |= value << _nbits;
+        _nbits += len;
+        while (_nbits >= 8) {
+            _byte(_bits);
+            _bits >>= 8;
+            _nbits -= 8;
+        }
+    }
+
+    void _byte(uint8_t b) {
+        _out[_olen++] = b;
+        if (_olen == sizeof(_out)) _flush();
+    }
+
+    void _flush() {
+        if (_olen) _p->write(_out, _olen);
+        _olen = 0;
+    }
+};
+
+// потоковая распаковка gzip (все типы блоков deflate). Сжатые данные подаются порциями любого размера,
+// распакованные уходят в write(data, len) вывода. Память: окно GHTTP_GUNZIP_WINDOW + ~1.5 кБ таблиц
+class GzipReader {
+    static const uint16_t WINDOW_MASK = GHTTP_GUNZIP_WINDOW - 1;
+    static_assert(GHTTP_GUNZIP_WINDOW >= 256 && GHTTP_GUNZIP_WINDOW <= 32768 && !(GHTTP_GUNZIP_WINDOW & WINDOW_MASK), "GHTTP_GUNZIP_WINDOW: power of 2 in 256..32768");
+
+    typedef bool (*Output)(void* out, uint8_t* data, size_t len);
+
+    enum class State : uint8_t {
+        Header,
+        HeaderRest,
+        Flags,
+        Extra,
+        Block,
+        StoredLen,
+        Stored,
+        Tables,
+        CodeLens,
+        Lengths,
+        Data,
+        Crc,
+        Size,
+        Done,
+        Error,
+    };
+
+   public:
+    // начать новый поток
+    void begin() {
+        _state = State::Header;
+        _acc = 0;
+        _nacc = 0;
+        _wpos = _from = 0;
+        _crc = 0;
+        _size = 0;
+        _last = false;
+    }
+
+    // распаковать порцию сжатых данных в out.write(uint8_t*, size_t). Данные после конца потока игнорируются.
+    // Вернёт false при ошибке формата или вывода
+    template <typename T>
+    bool decode(const uint8_t* data, size_t len, T& out) {
+        return _decode(data, len, [](void* p, uint8_t* buf, size_t n) { return ((T*)p)->write(buf, n) == n; }, &out);
+    }
+
+    // поток распакован целиком, контрольная сумма и размер совпали
+    bool done() const {
+        return _state == State::Done;
+    }
+
+    // ошибка формата или вывода
+    bool error() const {
+        return _state == State::Error;
+    }
+
+    // распаковано байт
+    uint32_t length() const {
+        return _size;
+    }
+
+   private:
+    uint8_t _win[GHTTP_GUNZIP_WINDOW];
+    uint8_t _lens[286 + 30];    // длины кодов динамического блока
+    uint16_t _lcount[16];       // кодов каждой длины: символы и длины (или коды длин при чтении таблиц)
+    uint16_t _lsym[286];
+    uint16_t _dcount[16];       // расстояния
+    uint16_t _dsym[30];
+    uint64_t _acc = 0;          // принятые биты, со младшего
+    uint8_t _nacc = 0;
+    State _state = State::Done;
+    bool _last = false;         // последний блок
+    uint8_t _flags = 0;
+    uint16_t _count = 0;        // счётчик текущего состояния
+    uint16_t _nlen = 0;
+    uint16_t _ndist = 0;
+    uint16_t _ncode = 0;
+    uint16_t _wpos = 0;         // позиция записи в окне
+    uint16_t _from = 0;         // начало невыведенных данных в окне
+    uint32_t _crc = 0;
+    uint32_t _size = 0;
+    Output _output = nullptr;
+    void* _out = nullptr;
+
+    bool _decode(const uint8_t* data, size_t len, Output output, void* out) {
+        _output = output;
+        _out = out;
+        while (_state != State::Done && _state != State::Error) {
+            if (_state == State::Stored && !_nacc) {
+                // несжатый блок копируется из входа напрямую
+                if (!len) break;
+                uint16_t n = min((size_t)_count, len);
+                n = min(n, (uint16_t)(GHTTP_GUNZIP_WINDOW - _wpos));
+                memcpy(_win + _wpos, data, n);
+                data += n;
+                len -= n;
+                _count -= n;
+                _advance(n);
+                if (!_count) _blockEnd();
+                continue;
+            }
+            while (_state != State::Stored && _nacc <= 56 && len) {
+                _acc |= (uint64_t)*data++ << _nacc;
+                _nacc += 8;
+                len--;
+            }
+            if (!_step()) break;
+        }
+        _flush();
+        return _state != State::Error;
+    }
+
+    // один шаг разбора. Каждый шаг требует не больше 48 бит, после данных потока всегда есть ещё 64 бита
+    // (конец блока и контрольная сумма), поэтому ожидание полного шага не задерживает распаковку.
+    // Вернёт false, если для шага мало данных
+    bool _step() {
+        switch (_state) {
+            case State::Header:
+                if (_nacc < 32) return false;
+                if (_bits(8) != 0x1f || _bits(8) != 0x8b || _bits(8) != 8) return _fail();
+                _flags = _bits(8);
+                _state = State::HeaderRest;
+                break;
+
+            case State::HeaderRest:  // время, флаги сжатия, ОС
+                if (_nacc < 48) return false;
+                _bits(24);
+                _bits(24);
+                _state = State::Flags;
+                break;
+
+            case State::Flags:
+                if (_flags & 0x04) {  // FEXTRA
+                    if (_nacc < 16) return false;
+                    _count = _bits(16);
+                    _flags &= ~0x04;
+                    _state = State::Extra;
+                } else if (_flags & 0x18) {  // FNAME, FCOMMENT до нулевого байта
+                    if (_nacc < 8) return false;
+                    if (!_bits(8)) _flags &= (_flags & 0x08) ? ~0x08 : ~0x10;
+                } else if (_flags & 0x02) {  // FHCRC
+                    if (_nacc < 16) return false;
+                    _bits(16);
+                    _flags &= ~0x02;
+                } else {
+                    _state = State::Block;
+                }
+                break;
+
+            case State::Extra:
+                if (_count) {
+                    if (_nacc < 8) return false;
+                    _bits(8);
+                    _count--;
+                } else {
+                    _state = State::Flags;
+                }
+                break;
+
+            case State::Block:
+                if (_nacc < 3) return false;
+                _last = _bits(1);
+                switch (_bits(2)) {
+                    case 0:
+                        _bits(_nacc & 7);
+                        _state = State::StoredLen;
+                        break;
+                    case 1:
+                        _fixed();
+                        _state = State::Data;
+                        break;
+                    case 2:
+                        _state = State::Tables;
+                        break;
+                    default:
+                        return _fail();
+                }
+                break;
+
+            case State::StoredLen:
+                if (_nacc < 32) return false;
+                _count = _bits(16);
+                if (_count != (uint16_t)~_bits(16)) return _fail();
+                if (_count) _state = State::Stored;
+                else _blockEnd();
+                break;
+
+            case State::Stored:
+                if (_nacc < 8) return false;
+                _put(_bits(8));
+                if (!--_count) _blockEnd();
+                break;
+
+            case State::Tables:
+                if (_nacc < 14) return false;
+                _nlen = _bits(5) + 257;
+                _ndist = _bits(5) + 1;
+                _ncode = _bits(4) + 4;
+                if (_nlen > 286 || _ndist > 30) return _fail();
+                memset(_lens, 0, 19);
+                _count = 0;
+                _state = State::CodeLens;
+                break;
+
+            case State::CodeLens: {
+                static const uint8_t order[] PROGMEM = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+                if (_nacc < 3) return false;
+                _lens[pgm_read_byte(order + _count)] = _bits(3);
+                if (++_count < _ncode) break;
+                if (!_build(_lcount, _lsym, _lens, 19)) return _fail();
+                _count = 0;
+                _state = State::Lengths;
+            } break;
+
+            case State::Lengths: {
+                if (_nacc < 14) return false;
+                int16_t sym = _symbol(_lcount, _lsym);
+                if (sym < 0) return _fail();
+                uint16_t total = _nlen + _ndist;
+                if (sym < 16) {
+                    _lens[_count++] = sym;
+                } else {
+                    uint8_t len = 0;
+                    uint8_t rep;
+                    if (sym == 16) {
+                        if (!_count) return _fail();
+                        len = _lens[_count - 1];
+                        rep = 3 + _bits(2);
+                    } else if (sym == 17) {
+                        rep = 3 + _bits(3);
+                    } else {
+                        rep = 11 + _bits(7);
+                    }
+                    if (_count + rep > total) return _fail();
+                    while (rep--) _lens[_count++] = len;
+                }
+                if (_count < total) break;
+                if (!_lens[256]) return _fail();  // нет кода конца блока
+                if (!_build(_lcount, _lsym, _lens, _nlen) || !_build(_dcount, _dsym, _lens + _nlen, _ndist)) return _fail();
+                _state = State::Data;
+            } break;
+
+            case State::Data: {
+                if (_nacc < 48) return false;
+                int16_t sym = _symbol(_lcount, _lsym);
+                if (sym < 0) return _fail();
+                if (sym < 256) {
+                    _put(sym);
+                    break;
+                }
+                if (sym == 256) {
+                    _blockEnd();
+                    break;
+                }
+                sym -= 257;
+                if (sym >= 29) return _fail();
+                uint16_t len = Deflate::lengthBase(sym) + _bits(Deflate::lengthExtra(sym));
+                sym = _symbol(_dcount, _dsym);
+                if (sym < 0 || sym >= 30) return _fail();
+                uint16_t dist = Deflate::distBase(sym) + _bits(Deflate::distExtra(sym));
+                if (dist > GHTTP_GUNZIP_WINDOW || dist > _size + (_wpos - _from)) return _fail();
+                uint16_t src = (_wpos - dist) & WINDOW_MASK;
+                while (len--) {
+                    _put(_win[src]);
+                    src = (src + 1) & WINDOW_MASK;
+                }
+            } break;
+
+            case State::Crc:
+                if (_nacc < 32) return false;
+                _flush();
+                if (_bits(16) != (_crc & 0xffff) || _bits(16) != (_crc >> 16)) return _fail();
+                _state = State::Size;
+                break;
+
+            case State::Size:
+                if (_nacc < 32) return false;
+                if (_bits(16) != (_size & 0xffff) || _bits(16) != (_size >> 16)) return _fail();
+                _state = State::Done;
+                break;
+
+            default:
+                return false;
+        }
+        return true;
+    }
+
+    uint32_t _bits(uint8_t n) {
+        uint32_t v = _acc & ((1ul << n) - 1);
+        _acc >>= n;
+        _nacc -= n;
+        return v;
+    }
+
+    void _blockEnd() {
+        if (_last) {
+            _bits(_nacc & 7);
+            _state = State::Crc;
+        } else {
+            _state = State::Block;
+        }
+    }
+
+    // фиксированные коды (блок типа 1)
+    void _fixed() {
+        uint16_t i = 0;
+        for (; i < 144; i++) _lens[i] = 8;
+        for (; i < 256; i++) _lens[i] = 9;
+        for (; i < 280; i++) _lens[i] = 7;
+        for (; i < 286; i++) _lens[i] = 8;
+        _build(_lcount, _lsym, _lens, 286);
+        memset(_lens, 5, 30);
+        _build(_dcount, _dsym, _lens, 30);
+    }
+
+    // канонический код Хаффмана по длинам кодов символов. false - кодов больше, чем возможно
+    static bool _build(uint16_t* count, uint16_t* sym, const uint8_t* lens, uint16_t n) {
+        uint16_t offs[16];
+        memset(count, 0, 16 * sizeof(uint16_t));
+        for (uint16_t i = 0; i < n; i++) count[lens[i]]++;
+        int16_t left = 1;
+        for (uint8_t len = 1; len < 16; len++) {
+            left = (left << 1) - count[len];
+            if (left < 0) return false;
+        }
+        offs[1] = 0;
+        for (uint8_t len = 1; len < 15; len++) offs[len + 1] = offs[len] + count[len];
+        for (uint16_t i = 0; i < n; i++) {
+            if (lens[i]) sym[offs[lens[i]]++] = i;
+        }
+        return true;
+    }
+
+    // прочитать символ по биту, коды пишутся со старшего бита. -1 - код не существует
+    int16_t _symbol(const uint16_t* count, const uint16_t* sym) {
+        int16_t code = 0, first = 0, index = 0;
+        for (uint8_t len = 1; len < 16; len++) {
+            code |= _bits(1);
+            int16_t n = count[len];
+            if (code - n < first) return sym[index + (code - first)];
+            index += n;
+            first = (first + n) << 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+
+    void _put(uint8_t b) {
+        _win[_wpos] = b;
+        _advance(1);
+    }
+
+    // записано n байт в окно, при заполнении окна они выводятся
+    void _advance(uint16_t n) {
+        _wpos += n;
+        if (_wpos == GHTTP_GUNZIP_WINDOW) {
+            _flush();
+            _wpos = _from = 0;
+        }
+    }
+
+    // вывести распакованные данные из окна
+    void _flush() {
+        uint16_t len = _wpos - _from;
+        if (!len || _state == State::Error) return;
+        _crc = Deflate::crc32(_crc, _win + _from, len);
+        _size += len;
+        if (!_output(_out, _win + _from, len)) _fail();
+        _from = _wpos;
+    }
+
+    bool _fail() {
+        _state = State::Error;
+        return false;
+    }
+};
+
+}  // namespace ghttp
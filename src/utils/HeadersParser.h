@@ -8,84 +8,292 @@
 
 namespace ghttp {
 
+// хэш строки без учёта регистра
+constexpr size_t hashi(const char* str, size_t hash = 5381) {
+    return *str ? hashi(str + 1, hash + (hash << 5) + ((*str >= 'A' && *str <= 'Z') ? (*str + 32) : *str)) : hash;
+}
+
+// хэш текста без учёта регистра
+inline size_t hashi(const Text& text) {
+    size_t hash = 5381;
+    for (uint16_t i = 0; i < text.length(); i++) {
+        char c = text[i];
+        hash = hash + (hash << 5) + ((c >= 'A' && c <= 'Z') ? (c + 32) : c);
+    }
+    return hash;
+}
+
+// текст совпадает с PROGMEM строкой без учёта регистра
+inline bool equalsi(const Text& text, PGM_P str) {
+    for (uint16_t i = 0; i < text.length(); i++) {
+        char c = pgm_read_byte(str + i);
+        if (!c || tolower(text[i]) != tolower(c)) return false;
+    }
+    return !pgm_read_byte(str + text.length());
+}
+
+// список через запятую содержит значение (без учёта регистра). Параметры значения после ';' не учитываются
+inline bool hasToken(const Text& list, PGM_P token) {
+    int16_t from = 0;
+    while (from <= (int16_t)list.length()) {
+        int16_t to = list.indexOf(',', from);
+        if (to < 0) to = list.length();
+        int16_t end = list.indexOf(';', from);
+        if (end < 0 || end > to) end = to;
+        if (equalsi(Text(list.str() + from, end - from).trim(), token)) return true;
+        from = to + 1;
+    }
+    return false;
+}
+
 class HeadersCollector {
    public:
     virtual void header(Text& name, Text& value) = 0;
 };
 
+// потоковый парсер стартовой строки и хэдеров. Работает во внешнем буфере без выделения памяти,
+// принимает данные порциями любого размера и продолжает разбор с места остановки.
+// Строка длиннее буфера - ошибка разбора с флагом overflow
 class HeadersParser {
+    enum class State : uint8_t {
+        Start,
+        Headers,
+        Done,
+    };
+
    public:
-    template <typename client_t>
-    HeadersParser(client_t& client, HeadersCollector* collector = nullptr) {
-        contentType.reserve(50);
-        String buf;
-
-        while (client.connected()) {
-            GHTTP_ESP_YIELD();
-            buf = client.readStringUntil('\n');
-            size_t n = buf.length();
-
-            if (!n || buf[n - 1] != '\r') break;  // пустая или не оканчивается на \r
-            if (n == 1) {                         // == \r
-                valid = true;
+    HeadersParser() {}
+
+    // buf - буфер для стартовой строки, значения Content-Type и текущей строки хэдера. start - ожидать стартовую строку
+    HeadersParser(char* buf, uint16_t size, bool start = true) : _buf(buf), _size(size), _state(start ? State::Start : State::Headers) {}
+
+    // разобрать порцию данных. Вернёт количество обработанных байт, разбор останавливается после конца хэдеров
+    size_t parse(const char* data, size_t len, HeadersCollector* collector = nullptr) {
+        size_t i = 0;
+        while (i < len && !done()) {
+            char c = data[i++];
+            if (c != '\n') {
+                if (_len < _size) {
+                    _buf[_len++] = c;
+                    continue;
+                }
+                overflow = true;
+                _fail();
                 break;
             }
 
-            Text header(buf.c_str(), n - 1);
+            if (_len == _line || _buf[_len - 1] != '\r') {
+                _fail();
+                break;
+            }
+            _parseLine(Text(_buf + _line, _len - _line - 1), collector);
+        }
+        GHTTP_METRIC(received += i;)
+        return i;
+    }
+
+    // прочитать доступные данные из клиента без ожидания. Вернёт true, когда разбор завершён
+    template <typename client_t>
+    bool parse(client_t& client, HeadersCollector* collector = nullptr) {
+        char buf[4];
+        while (!done()) {
+            int len = min(client.available(), (int)_need());
+            if (len <= 0) break;
+            len = client.read((uint8_t*)buf, len);
+            if (len <= 0) break;
+            parse(buf, len, collector);
+        }
+        return done();
+    }
+
+    // прочитать хэдеры из клиента с ожиданием по таймауту клиента. Вернёт true при успехе
+    template <typename client_t>
+    bool read(client_t& client, HeadersCollector* collector = nullptr) {
+        char buf[4];
+        while (!done() && client.connected()) {
+            size_t len = client.readBytes(buf, _need());
+            if (!len) break;
+            parse(buf, len, collector);
+        }
+        return valid;
+    }
+
+    // разбор завершён (успешно или с ошибкой)
+    bool done() const {
+        return _state == State::Done;
+    }
+
+    // данные ещё не поступали
+    bool empty() const {
+        return _state == State::Start && !_len;
+    }
+
+    // стартовая строка (запрос или статус ответа)
+    Text startLine() const {
+        return Text(_buf, _start);
+    }
 
+    // разобрать строку хэдера (без \r\n)
+    void parseLine(const Text& header, HeadersCollector* collector = nullptr) {
 #ifdef GHTTP_HEADERS_LOG
-            GHTTP_HEADERS_LOG.println(header);
+        GHTTP_HEADERS_LOG.println(header);
 #endif
 
-            int16_t colon = header.indexOf(':');
-            if (colon > 0) {
-                Text name = header.substring(0, colon);
-                Text value = header.substring(colon + 1).trim();
-
-                if (collector) collector->header(name, value);
-
-                switch (name.hash()) {
-                    case SH("Content-Type"):
-                    case SH("content-type"):
-                    case SH("CONTENT-TYPE"):
-                        value.addString(contentType);
-                        break;
-
-                    case SH("Content-Length"):
-                    case SH("content-length"):
-                    case SH("CONTENT-LENGTH"):
-                        length = value.toInt32();
-                        break;
-
-                    case SH("Transfer-Encoding"):
-                    case SH("transfer-encoding"):
-                    case SH("TRANSFER-ENCODING"):
-                        chunked = (value == F("chunked") || value == F("CHUNKED"));
-                        break;
-
-                    case SH("Connection"):
-                    case SH("connection"):
-                    case SH("CONNECTION"):
-                        close = (value == F("close") || value == F("CLOSE"));
-                        break;
-                }
+        int16_t colon = header.indexOf(':');
+        if (colon > 0) {
+            Text name = header.substring(0, colon);
+            Text value = header.substring(colon + 1).trim();
+
+            if (collector) collector->header(name, value);
+
+            // совпадение хэша подтверждается сравнением имени
+            switch (hashi(name)) {
+                case hashi("content-type"):
+                    if (!equalsi(name, PSTR("content-type"))) break;
+                    if (!contentType.length()) contentType = _store(value);
+                    break;
+
+                case hashi("content-length"):
+                    if (!equalsi(name, PSTR("content-length"))) break;
+                    if (!_length(value)) _fail();
+                    break;
+
+                case hashi("transfer-encoding"):
+                    if (!equalsi(name, PSTR("transfer-encoding"))) break;
+                    chunked = hasToken(value, PSTR("chunked"));
+                    break;
+
+                case hashi("connection"):
+                    if (!equalsi(name, PSTR("connection"))) break;
+                    close = hasToken(value, PSTR("close"));
+                    keepAlive = hasToken(value, PSTR("keep-alive"));
+                    upgrade = hasToken(value, PSTR("upgrade"));
+                    break;
+
+                case hashi("content-encoding"):
+                    if (!equalsi(name, PSTR("content-encoding"))) break;
+                    gzip = hasToken(value, PSTR("gzip"));
+                    break;
+
+                case hashi("accept-encoding"):
+                    if (!equalsi(name, PSTR("accept-encoding"))) break;
+                    acceptGzip = hasToken(value, PSTR("gzip"));
+                    break;
+
+                case hashi("if-none-match"):
+                    if (!equalsi(name, PSTR("if-none-match"))) break;
+                    if (!ifNoneMatch.length()) ifNoneMatch = _store(value);
+                    break;
+
+                case hashi("content-disposition"):
+                    if (!equalsi(name, PSTR("content-disposition"))) break;
+                    if (!contentDisposition.length()) contentDisposition = _store(value);
+                    break;
+
+                case hashi("range"):
+                    if (!equalsi(name, PSTR("range"))) break;
+                    if (!range.length()) range = _store(value);
+                    break;
+
+                case hashi("upgrade"):
+                    if (!equalsi(name, PSTR("upgrade"))) break;
+                    websocket = hasToken(value, PSTR("websocket"));
+                    break;
+
+                case hashi("sec-websocket-key"):
+                    if (!equalsi(name, PSTR("sec-websocket-key"))) break;
+                    if (!wsKey.length()) wsKey = _store(value);
+                    break;
+
+                case hashi("sec-websocket-version"):
+                    if (!equalsi(name, PSTR("sec-websocket-version"))) break;
+                    wsVersion = value.toInt32();
+                    break;
             }
         }
     }
 
-    // legacy
-    template <typename client_t>
-    HeadersParser(client_t& client, size_t, HeadersCollector* collector = nullptr) : HeadersParser(client, collector) {}
-
-    String contentType;
+    Text contentType;
+    Text contentDisposition;
+    Text ifNoneMatch;
+    Text range;
+    Text wsKey;             // Sec-WebSocket-Key
     size_t length = 0;
+    bool hasLength = false;  // Content-Length получен
+    uint16_t wsVersion = 0; // Sec-WebSocket-Version
     bool close = false;
+    bool keepAlive = false;
+    bool upgrade = false;   // Connection: upgrade
     bool valid = false;
     bool chunked = false;
+    bool acceptGzip = false;
+    bool gzip = false;      // Content-Encoding: gzip
+    bool websocket = false; // Upgrade: websocket
+    bool overflow = false;
+    GHTTP_METRIC(size_t received = 0;)  // обработано байт
 
     operator bool() {
         return valid;
     }
+
+   private:
+    char* _buf = nullptr;
+    uint16_t _size = 0;
+    uint16_t _len = 0;
+    uint16_t _line = 0;
+    uint16_t _start = 0;
+    State _state = State::Start;
+
+    void _parseLine(const Text& line, HeadersCollector* collector) {
+        if (_state == State::Start) {
+            if (line.length()) {  // пустые строки перед стартовой пропускаются
+                _start = line.length();
+                _line = _len;
+                _state = State::Headers;
+            }
+        } else if (line.length()) {
+            parseLine(line, collector);
+        } else {
+            valid = true;
+            _state = State::Done;
+        }
+        _len = _line;
+    }
+
+    // сохранить значение в буфере до конца разбора. Значение находится в текущей строке
+    Text _store(const Text& value) {
+        if (!_buf || value.str() < _buf + _line || value.str() >= _buf + _size) return Text();
+        memmove(_buf + _line, value.str(), value.length());
+        Text t(_buf + _line, value.length());
+        _line += value.length();
+        return t;
+    }
+
+    // Content-Length - только цифры, без переполнения
+    bool _length(const Text& value) {
+        if (!value.length()) return false;
+        size_t len = 0;
+        for (uint16_t i = 0; i < value.length(); i++) {
+            char c = value[i];
+            if (c < '0' || c > '9' || len > ((size_t)-1 - (c - '0')) / 10) return false;
+            len = len * 10 + (c - '0');
+        }
+        length = len;
+        hasLength = true;
+        return true;
+    }
+
+    // минимум байт до конца хэдеров: из клиента читается не больше, данные тела остаются в клиенте
+    uint8_t _need() const {
+        if (_state == State::Headers && _len == _line) return 2;
+        if (_state == State::Headers && _len == _line + 1 && _buf[_line] == '\r') return 1;
+        return (_len > _line && _buf[_len - 1] == '\r') ? 3 : 4;
+    }
+
+    void _fail() {
+        valid = false;
+        _state = State::Done;
+    }
 };
 
-}  // namespace ghttp
\ No newline at end of file
+}  // namespace ghttp
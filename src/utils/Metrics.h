@@ -0,0 +1,177 @@
+#pragma once
+#include <Arduino.h>
+#include <StringUtils.h>
+
+#include "cfg.h"
+
+#ifdef GHTTP_METRICS
+
+#ifndef GHTTP_FREE_HEAP
+#if defined(ESP8266) || defined(ESP32)
+#define GHTTP_FREE_HEAP() ESP.getFreeHeap()  // свободная куча, байт
+#else
+#define GHTTP_FREE_HEAP() 0                  // свободная куча, байт
+#endif
+#endif
+
+namespace ghttp {
+
+class ServerBase;
+
+// замеры одного запроса сервера. Время - micros() в момент события, 0 - событие не наступило
+class RequestMetrics {
+    friend class ServerBase;
+
+   public:
+    Text method;                // метод, действителен только в обработчике метрик
+    Text url;                   // урл, действителен только в обработчике метрик
+    uint32_t accept = 0;        // подключение принято или получен первый байт следующего keep-alive запроса
+    uint32_t headers = 0;       // хэдеры разобраны
+    uint32_t handlerStart = 0;  // вызван обработчик
+    uint32_t handlerEnd = 0;    // обработчик завершён
+    uint32_t sent = 0;          // отправлен последний байт ответа
+    uint32_t bytesIn = 0;       // принято байт: стартовая строка, хэдеры и прочитанное тело
+    uint32_t bytesOut = 0;      // отправлено байт ответа
+    uint32_t heap = 0;          // наибольший расход кучи за запрос по замерам в начале и конце фаз, байт
+    uint16_t code = 0;          // код ответа
+
+    // длительность запроса, мкс
+    uint32_t duration() const {
+        return sent - accept;
+    }
+
+    // длительность обработчика, мкс
+    uint32_t handler() const {
+        return handlerStart ? handlerEnd - handlerStart : 0;
+    }
+
+   private:
+    uint32_t _free = 0;
+
+    void _heapCheck() {
+        uint32_t free = GHTTP_FREE_HEAP();
+        if (!_free) _free = free;
+        else if (_free > free && _free - free > heap) heap = _free - free;
+    }
+};
+
+// накопительные счётчики сервера или клиента
+class Metrics {
+   public:
+    uint32_t requests = 0;      // завершено запросов
+    uint32_t codes[5] = {};     // ответов по классам кодов 1xx..5xx
+    uint32_t bytesIn = 0;       // принято байт
+    uint32_t bytesOut = 0;      // отправлено байт
+    uint32_t connections = 0;   // новых подключений
+    uint32_t timeouts = 0;      // запросов, прерванных по таймауту
+    uint32_t parseErrors = 0;   // ошибок разбора запроса или ответа
+    uint32_t errors = 0;        // прочих ошибок: подключение, разрыв
+    uint64_t time = 0;          // суммарная длительность запросов, мкс
+    uint32_t timeMax = 0;       // наибольшая длительность запроса, мкс
+    uint64_t handlerTime = 0;   // суммарная длительность обработчиков сервера, мкс
+    uint32_t handlerMax = 0;    // наибольшая длительность обработчика сервера, мкс
+    uint32_t heap = 0;          // наибольший расход кучи за запрос, байт
+
+    // учесть код ответа и длительность запроса в мкс
+    void count(uint16_t code, uint32_t us) {
+        requests++;
+        if (code >= 100 && code < 600) codes[code / 100 - 1]++;
+        time += us;
+        if (us > timeMax) timeMax = us;
+    }
+
+    // учесть завершённый запрос сервера
+    void count(const RequestMetrics& m) {
+        count(m.code, m.duration());
+        bytesIn += m.bytesIn;
+        bytesOut += m.bytesOut;
+        handlerTime += m.handler();
+        if (m.handler() > handlerMax) handlerMax = m.handler();
+        if (m.heap > heap) heap = m.heap;
+    }
+
+    // вывести в текстовом формате Prometheus (строки через \n). prefix - начало имён ("ghttp_server"),
+    // handler - выводить длительность обработчиков (сервер)
+    void printTo(Print& p, const __FlashStringHelper* prefix, bool handler = false) const {
+        _counter(p, prefix, F("requests_total"), requests);
+        _type(p, prefix, F("responses_total"), F("counter"));
+        for (uint8_t i = 0; i < 5; i++) {
+            p.print(prefix);
+            p.print(F("_responses_total{code=\""));
+            p.print(i + 1);
+            p.print(F("xx\"} "));
+            p.print(codes[i]);
+            p.print('\n');
+        }
+        _counter(p, prefix, F("received_bytes_total"), bytesIn);
+        _counter(p, prefix, F("sent_bytes_total"), bytesOut);
+        _counter(p, prefix, F("connections_total"), connections);
+        _counter(p, prefix, F("timeouts_total"), timeouts);
+        _counter(p, prefix, F("parse_errors_total"), parseErrors);
+        _counter(p, prefix, F("errors_total"), errors);
+        _summary(p, prefix, F("request_seconds"), time, timeMax);
+        if (handler) _summary(p, prefix, F("handler_seconds"), handlerTime, handlerMax);
+        _type(p, prefix, F("heap_peak_bytes"), F("gauge"));
+        _value(p, prefix, F("heap_peak_bytes"), F(""), heap);
+    }
+
+   private:
+    static void _type(Print& p, const __FlashStringHelper* prefix, const __FlashStringHelper* name, const __FlashStringHelper* type) {
+        p.print(F("# TYPE "));
+        p.print(prefix);
+        p.print('_');
+        p.print(name);
+        p.print(' ');
+        p.print(type);
+        p.print('\n');
+    }
+
+    static void _value(Print& p, const __FlashStringHelper* prefix, const __FlashStringHelper* name, const __FlashStringHelper* suffix, uint32_t value) {
+        p.print(prefix);
+        p.print('_');
+        p.print(name);
+        p.print(suffix);
+        p.print(' ');
+        p.print(value);
+        p.print('\n');
+    }
+
+    static void _counter(Print& p, const __FlashStringHelper* prefix, const __FlashStringHelper* name, uint32_t value) {
+        _type(p, prefix, name, F("counter"));
+        _value(p, prefix, name, F(""), value);
+    }
+
+    // сумма и количество как summary, максимум отдельным gauge
+    void _summary(Print& p, const __FlashStringHelper* prefix, const __FlashStringHelper* name, uint64_t sum, uint32_t max) const {
+        _type(p, prefix, name, F("summary"));
+        p.print(prefix);
+        p.print('_');
+        p.print(name);
+        p.print(F("_sum "));
+        _seconds(p, sum);
+        _value(p, prefix, name, F("_count"), requests);
+        p.print(F("# TYPE "));
+        p.print(prefix);
+        p.print('_');
+        p.print(name);
+        p.print(F("_max gauge\n"));
+        p.print(prefix);
+        p.print('_');
+        p.print(name);
+        p.print(F("_max "));
+        _seconds(p, max);
+    }
+
+    // мкс в секундах с дробной частью
+    static void _seconds(Print& p, uint64_t us) {
+        char frac[8];
+        snprintf(frac, sizeof(frac), ".%06lu", (unsigned long)(us % 1000000));
+        p.print((unsigned long)(us / 1000000));
+        p.print(frac);
+        p.print('\n');
+    }
+};
+
+}  // namespace ghttp
+
+#endif
@@ -0,0 +1,239 @@
+#pragma once
+#include <Arduino.h>
+#include <StringUtils.h>
+
+#include "BlockPool.h"
+#include "HeadersParser.h"
+#include "cfg.h"
+
+#ifndef __AVR__
+#include <functional>
+#endif
+
+#ifndef HS_MULTIPART_BLOCK
+#ifdef __AVR__
+#define HS_MULTIPART_BLOCK 128  // окно чтения тела multipart, берётся из пула блоков
+#else
+#define HS_MULTIPART_BLOCK 512  // окно чтения тела multipart, берётся из пула блоков
+#endif
+#endif
+
+#ifndef HS_PART_HEADERS_SIZE
+#ifdef __AVR__
+#define HS_PART_HEADERS_SIZE 96     // буфер хэдеров части multipart
+#else
+#define HS_PART_HEADERS_SIZE 256    // буфер хэдеров части multipart
+#endif
+#endif
+
+namespace ghttp {
+
+// потоковый парсер multipart/form-data. Тело читается окном фиксированного размера,
+// граница ищется алгоритмом Бойера-Мура-Хорспула, данные частей передаются в обработчик порциями
+class Multipart {
+    enum class State : uint8_t {
+        Preamble,
+        Boundary,
+        Headers,
+        Body,
+        Done,
+    };
+
+    // "\r\n--" + boundary до 70 символов
+    static const uint8_t DELIM_SIZE = 4 + 70;
+
+   public:
+    class Part {
+        friend class Multipart;
+
+       public:
+        // имя поля
+        Text name;
+
+        // имя файла, пустое для обычного поля
+        Text filename;
+
+        // тип содержимого, пустой если не указан
+        Text type;
+
+        // смещение текущей порции данных от начала части
+        size_t index = 0;
+
+        // последняя порция данных части
+        bool final = false;
+    };
+
+#ifdef __AVR__
+    typedef void (*PartCallback)(Part& part, const uint8_t* data, size_t len);
+#else
+    typedef std::function<void(Part& part, const uint8_t* data, size_t len)> PartCallback;
+#endif
+
+    // contentType - значение Content-Type запроса, содержащее boundary
+    Multipart(const Text& contentType) {
+        Text bound = _param(contentType, PSTR("boundary"));
+        if (!contentType.startsWith(F("multipart")) || !bound.length() || bound.length() > DELIM_SIZE - 4) return;
+
+        memcpy(_delim, "\r\n--", 4);
+        for (uint8_t i = 0; i < bound.length(); i++) _delim[4 + i] = bound[i];
+        _dlen = 4 + bound.length();
+
+        for (uint16_t i = 0; i < 256; i++) _skip[i] = _dlen;
+        for (uint8_t i = 0; i < _dlen - 1; i++) _skip[(uint8_t)_delim[i]] = _dlen - 1 - i;
+    }
+
+    // boundary найден
+    operator bool() const {
+        return _dlen;
+    }
+
+    // прочитать тело из потока, обработчик вызывается для каждой порции данных каждой части
+    // (для пустой части - один раз с len 0). Вернёт true, если тело завершено закрывающей границей
+    bool read(Stream& body, PartCallback cb) {
+        if (!_dlen) return false;
+        _state = State::Preamble;
+        _error = false;
+
+        PoolBlock block(HS_MULTIPART_BLOCK);
+        if (block.size() <= _dlen + 2u) return false;  // окно должно вмещать границу
+        uint8_t* buf = block.buf();
+        size_t size = block.size();
+        buf[0] = '\r';  // первая граница идёт без \r\n
+        buf[1] = '\n';
+        size_t len = 2;
+        bool eof = false;
+
+        while (1) {
+            GHTTP_ESP_YIELD();
+            if (!eof && len < size) {
+                size_t read = body.readBytes(buf + len, size - len);
+                if (!read) eof = true;
+                len += read;
+            }
+
+            size_t pos = 0;
+            while (pos < len && _state != State::Done) {
+                size_t n = _step(buf + pos, len - pos, cb);
+                if (!n) break;
+                pos += n;
+            }
+            if (_state == State::Done) return !_error;
+            if (eof && !pos) return false;  // тело закончилось без закрывающей границы
+
+            len -= pos;
+            memmove(buf, buf + pos, len);
+        }
+    }
+
+   private:
+    char _delim[DELIM_SIZE];
+    uint8_t _dlen = 0;
+    uint8_t _skip[256];
+    char _hbuf[HS_PART_HEADERS_SIZE];
+    HeadersParser _headers;
+    Part _part;
+    State _state = State::Preamble;
+    bool _error = false;
+
+    // обработать данные в текущем состоянии. Вернёт количество использованных байт, 0 - нужно больше данных
+    size_t _step(const uint8_t* data, size_t len, PartCallback& cb) {
+        switch (_state) {
+            case State::Preamble:
+            case State::Body: {
+                int32_t pos = _find(data, len);
+                if (pos < 0) {
+                    // хвост окна может оказаться началом границы
+                    size_t safe = (len >= _dlen) ? len - (_dlen - 1) : 0;
+                    if (safe && _state == State::Body) _emit(cb, data, safe, false);
+                    return safe;
+                }
+                if (_state == State::Body) _emit(cb, data, pos, true);
+                _state = State::Boundary;
+                return pos + _dlen;
+            }
+
+            case State::Boundary:
+                if (len < 2) return 0;
+                if (data[0] == '-' && data[1] == '-') {
+                    _state = State::Done;
+                } else if (data[0] == '\r' && data[1] == '\n') {
+                    _headers = HeadersParser(_hbuf, HS_PART_HEADERS_SIZE, false);
+                    _state = State::Headers;
+                } else {
+                    _error = true;
+                    _state = State::Done;
+                }
+                return 2;
+
+            case State::Headers: {
+                size_t n = _headers.parse((const char*)data, len);
+                if (_headers.done()) {
+                    if (!_headers) {
+                        _error = true;
+                        _state = State::Done;
+                    } else {
+                        _part = Part();
+                        _part.name = _param(_headers.contentDisposition, PSTR("name"));
+                        _part.filename = _param(_headers.contentDisposition, PSTR("filename"));
+                        _part.type = _headers.contentType;
+                        _state = State::Body;
+                    }
+                }
+                return n;
+            }
+
+            case State::Done:
+                break;
+        }
+        return 0;
+    }
+
+    void _emit(PartCallback& cb, const uint8_t* data, size_t len, bool final) {
+        _part.final = final;
+        if (cb) cb(_part, data, len);
+        _part.index += len;
+    }
+
+    // поиск границы алгоритмом Хорспула
+    int32_t _find(const uint8_t* data, size_t len) const {
+        size_t last = _dlen - 1;
+        size_t i = 0;
+        while (i + last < len) {
+            uint8_t c = data[i + last];
+            if (c == (uint8_t)_delim[last] && !memcmp(data + i, _delim, last)) return i;
+            i += _skip[c];
+        }
+        return -1;
+    }
+
+    // значение параметра key из списка "value; key=val; key2="val2"". ';' внутри кавычек не разделяет параметры
+    static Text _param(const Text& list, PGM_P key) {
+        int16_t from = _next(list, 0);
+        while (from < (int16_t)list.length()) {
+            int16_t to = _next(list, from + 1);
+            Text p = Text(list.str() + from + 1, to - from - 1, list.pgm()).trim();
+            int16_t eq = p.indexOf('=');
+            if (eq > 0 && equalsi(Text(p.str(), eq, p.pgm()).trim(), key)) {
+                Text val = Text(p.str() + eq + 1, p.length() - eq - 1, p.pgm()).trim();
+                if (val.length() >= 2 && val[0] == '"' && val[val.length() - 1] == '"') val = Text(val.str() + 1, val.length() - 2, val.pgm());
+                return val;
+            }
+            from = to;
+        }
+        return Text();
+    }
+
+    // позиция следующего ';' вне кавычек, начиная с from. Длина списка, если не найден
+    static int16_t _next(const Text& list, int16_t from) {
+        bool quote = false;
+        for (; from < (int16_t)list.length(); from++) {
+            char c = list[from];
+            if (c == '"') quote = !quote;
+            else if (c == '\\' && quote) from++;
+            else if (c == ';' && !quote) break;
+        }
+        return (from < (int16_t)list.length()) ? from : list.length();
+    }
+};
+
+}  // namespace ghttp
@@ -0,0 +1,139 @@
+#pragma once
+#include <Arduino.h>
+
+#include "../StreamWriter.h"
+
+namespace ghttp {
+
+// буфер вывода: копит мелкие записи и отправляет их одним блоком при заполнении или в конце ответа.
+// В режиме chunked каждый отправляемый блок оформляется как chunk
+class OutputBuffer : public Print {
+    // резерв под заголовок chunk (4 hex + \r\n) и \r\n в конце
+    static const uint8_t CHUNK_HEAD = 6;
+    static const uint8_t CHUNK_TAIL = 2;
+
+   public:
+    // подключить вывод. buf - буфер размера size, nullptr - без буферизации (макс. 65535 байт)
+    void begin(Print* p, uint8_t* buf, uint16_t size) {
+        _p = p;
+        _buf = buf;
+        _size = buf ? size : 0;
+        _len = 0;
+        _chunked = _inChunk = false;
+        GHTTP_METRIC(sent = 0;)
+    }
+
+    // данные после этого вызова отправляются в формате chunked
+    void setChunked(bool chunked) {
+        flush();
+        _chunked = chunked;
+    }
+
+    // режим chunked
+    bool chunked() const {
+        return _chunked;
+    }
+
+    // свободное место в буфере для данных
+    size_t space() const {
+        size_t res = _len + (_chunked ? (_inChunk ? 0 : CHUNK_HEAD) + CHUNK_TAIL : 0);
+        return (_size > res) ? _size - res : 0;
+    }
+
+    // дописать в буфер следующую порцию данных из writer
+    size_t fill(StreamWriter& writer) {
+        size_t len = space();
+        if (!len) return 0;
+        _beginChunk();
+        len = writer.readNext(_buf + _len, len);
+        _len += len;
+        return len;
+    }
+
+    using Print::write;
+    size_t write(uint8_t data) {
+        return write(&data, 1);
+    }
+    size_t write(const uint8_t* data, size_t len) {
+        if (!_p || !len) return 0;
+
+        if (len > space()) {
+            flush();
+            if (len > space()) return _writeDirect(data, len);
+        }
+        _beginChunk();
+        memcpy(_buf + _len, data, len);
+        _len += len;
+        return len;
+    }
+
+    // отправить накопленные данные
+    void flush() {
+        if (_inChunk) {
+            uint16_t dlen = _len - _chunk - CHUNK_HEAD;
+            if (dlen) {
+                for (int8_t i = 3; i >= 0; i--) {
+                    uint8_t d = dlen & 0xf;
+                    _buf[_chunk + i] = d < 10 ? d + '0' : d - 10 + 'a';
+                    dlen >>= 4;
+                }
+                _buf[_len++] = '\r';
+                _buf[_len++] = '\n';
+            } else {
+                _len = _chunk;  // пустой chunk не отправляется
+            }
+            _inChunk = false;
+        }
+        if (_len && _p) {
+            size_t n = _p->write(_buf, _len);
+            GHTTP_METRIC(sent += n;)
+            (void)n;
+        }
+        _len = 0;
+    }
+
+    // завершить вывод: последний chunk и отправка буфера
+    void end() {
+        if (_chunked) {
+            flush();
+            _chunked = false;
+            print(F("0\r\n\r\n"));
+        }
+        flush();
+        _p = nullptr;
+    }
+
+    GHTTP_METRIC(size_t sent = 0;)  // отправлено байт с begin()
+
+   private:
+    Print* _p = nullptr;
+    uint8_t* _buf = nullptr;
+    uint16_t _size = 0;
+    uint16_t _len = 0;
+    uint16_t _chunk = 0;
+    bool _chunked = false;
+    bool _inChunk = false;
+
+    void _beginChunk() {
+        if (!_chunked || _inChunk) return;
+        _inChunk = true;
+        _chunk = _len;
+        memcpy_P(_buf + _len, PSTR("0000\r\n"), CHUNK_HEAD);
+        _len += CHUNK_HEAD;
+    }
+
+    size_t _writeDirect(const uint8_t* data, size_t len) {
+        size_t n = 0;
+        if (_chunked) {
+            n += _p->print(len, HEX);
+            n += _p->print(F("\r\n"));
+        }
+        n += StreamWriter(data, len).printTo(*_p);
+        if (_chunked) n += _p->print(F("\r\n"));
+        GHTTP_METRIC(sent += n;)
+        (void)n;
+        return len;
+    }
+};
+
+}  // namespace ghttp
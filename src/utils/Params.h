@@ -0,0 +1,202 @@
+#pragma once
+#include <Arduino.h>
+#include <StringUtils.h>
+
+#include "cfg.h"
+
+#ifndef HS_PARAMS_MAX
+#ifdef __AVR__
+#define HS_PARAMS_MAX 6         // макс. параметров запроса в индексе
+#else
+#define HS_PARAMS_MAX 16        // макс. параметров запроса в индексе
+#endif
+#endif
+
+#ifndef HS_FORM_SIZE
+#ifdef __AVR__
+#define HS_FORM_SIZE 64         // буфер декодированных параметров запроса и тела application/x-www-form-urlencoded
+#else
+#define HS_FORM_SIZE 1024       // буфер декодированных параметров запроса и тела application/x-www-form-urlencoded
+#endif
+#endif
+
+namespace ghttp {
+
+// индекс параметров "key=value&key2=value2". Строка разбирается один раз при первом обращении, поиск по хэшу ключа.
+// Ключи и значения без %XX и + ссылаются на исходную строку, остальные декодируются в буфер HS_FORM_SIZE - исходная строка не изменяется
+class Params {
+   public:
+    Params() {}
+    Params(const Params&) = delete;
+    Params& operator=(const Params&) = delete;
+
+    ~Params() {
+        delete[] _buf;
+    }
+
+    // задать строку параметров. Будет разобрана при первом обращении
+    void begin(const Text& query) {
+        _query = query;
+        _len = 0;
+        _used = 0;
+        _parsed = false;
+        _form = false;
+        _overflow = false;
+    }
+
+    // получить значение по ключу. Параметр без значения вернёт валидную пустую строку, отсутствующий - невалидную
+    Text get(const Text& key) {
+        _parse();
+        size_t hash = key.hash();
+        for (uint8_t i = 0; i < _len; i++) {
+            if (_hash[i] == hash && _keys[i] == key) return _vals[i];
+        }
+        return Text();
+    }
+
+    // есть параметр с ключом
+    bool has(const Text& key) {
+        return get(key).valid();
+    }
+
+    // количество параметров
+    uint8_t length() {
+        _parse();
+        return _len;
+    }
+
+    // ключ по порядку
+    Text key(uint8_t i) {
+        _parse();
+        return (i < _len) ? _keys[i] : Text();
+    }
+
+    // значение по порядку
+    Text value(uint8_t i) {
+        _parse();
+        return (i < _len) ? _vals[i] : Text();
+    }
+
+    // параметров больше HS_PARAMS_MAX или декодированные не поместились в буфер, лишние не попали в индекс
+    bool overflow() {
+        _parse();
+        return _overflow;
+    }
+
+    // прочитать тело application/x-www-form-urlencoded в свободную часть буфера HS_FORM_SIZE и добавить его параметры
+    // в индекс. Тело с известной длиной больше свободного места не читается. Вернёт false, если тело не поместилось
+    template <typename T>
+    bool readForm(T& reader) {
+        _parse();
+        if (_form) return true;
+        size_t space = HS_FORM_SIZE - _used;
+        if (!reader.isChunked() && reader.length() > space) return false;
+        if (!_alloc()) return false;
+
+        char* str = _buf + _used;
+        size_t len = 0;
+        while (len < space) {
+            size_t read = reader.readBytes(str + len, space - len);
+            if (!read) break;
+            len += read;
+        }
+        if (reader.available()) return false;
+        _form = true;
+        _used += len;
+        _add(str, len, false);
+        return true;
+    }
+
+    // декодировать %XX и + на месте. Вернёт новую длину
+    static size_t decode(char* str, size_t len) {
+        size_t w = 0;
+        for (size_t r = 0; r < len; r++, w++) {
+            char c = str[r];
+            if (c == '+') {
+                c = ' ';
+            } else if (c == '%' && r + 2 < len) {
+                int8_t h = _hex(str[r + 1]), l = _hex(str[r + 2]);
+                if (h >= 0 && l >= 0) {
+                    c = (h << 4) | l;
+                    r += 2;
+                }
+            }
+            str[w] = c;
+        }
+        return w;
+    }
+
+   private:
+    Text _query;
+    Text _keys[HS_PARAMS_MAX];
+    Text _vals[HS_PARAMS_MAX];
+    size_t _hash[HS_PARAMS_MAX];
+    char* _buf = nullptr;
+    size_t _used = 0;
+    uint8_t _len = 0;
+    bool _parsed = false;
+    bool _form = false;
+    bool _overflow = false;
+
+    void _parse() {
+        if (_parsed) return;
+        _parsed = true;
+        if (_query.length() && !_query.pgm()) _add((char*)_query.str(), _query.length(), true);
+    }
+
+    bool _alloc() {
+        return _buf || (_buf = new char[HS_FORM_SIZE]);
+    }
+
+    // ключ или значение. copy - строку нельзя изменять, при наличии %XX и + она декодируется в буфер.
+    // Вернёт невалидную строку, если буфер заполнен
+    Text _field(char* str, size_t len, bool copy) {
+        if (copy) {
+            size_t i = 0;
+            while (i < len && str[i] != '%' && str[i] != '+') i++;
+            if (i == len) return Text(str, len);
+            if (len > HS_FORM_SIZE - _used || !_alloc()) return Text();
+            memcpy(_buf + _used, str, len);
+            str = _buf + _used;
+            len = decode(str, len);
+            _used += len;
+            return Text(str, len);
+        }
+        return Text(str, decode(str, len));
+    }
+
+    // добавить параметры строки. copy - исходную строку нельзя изменять
+    void _add(char* str, size_t len, bool copy) {
+        size_t from = 0;
+        while (from < len) {
+            size_t to = from;
+            while (to < len && str[to] != '&') to++;
+            if (to > from) {
+                if (_len == HS_PARAMS_MAX) {
+                    _overflow = true;
+                    return;
+                }
+                size_t eq = from;
+                while (eq < to && str[eq] != '=') eq++;
+                _keys[_len] = _field(str + from, eq - from, copy);
+                _vals[_len] = (eq < to) ? _field(str + eq + 1, to - eq - 1, copy) : Text("", 0);
+                if (!_keys[_len].valid() || !_vals[_len].valid()) {
+                    _overflow = true;
+                    return;
+                }
+                _hash[_len] = _keys[_len].hash();
+                _len++;
+            }
+            from = to + 1;
+        }
+    }
+
+    static int8_t _hex(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        c |= 0x20;
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return -1;
+    }
+};
+
+}  // namespace ghttp
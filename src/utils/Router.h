@@ -0,0 +1,185 @@
+#pragma once
+#include <Arduino.h>
+#include <StringUtils.h>
+
+#ifndef HS_ROUTE_DEPTH
+#define HS_ROUTE_DEPTH 8        // макс. количество сегментов пути в маршрутах с параметрами
+#endif
+
+namespace ghttp {
+
+class RouterBase {
+   public:
+    // разбить путь на непустые сегменты
+    static uint8_t split(const Text& path, Text* segs, uint8_t len) {
+        uint8_t n = 0;
+        int16_t from = 0;
+        while (n < len && from < (int16_t)path.length()) {
+            int16_t to = path.indexOf('/', from);
+            if (to < 0) to = path.length();
+            if (to > from) segs[n++] = Text(path.str() + from, to - from, path.pgm());
+            from = to + 1;
+        }
+        return n;
+    }
+
+    // получить остаток пути начиная с сегмента idx
+    static Text tail(const Text& path, uint8_t idx) {
+        int16_t from = 0;
+        while (from < (int16_t)path.length()) {
+            if (path[from] == '/') {
+                from++;
+                continue;
+            }
+            if (!idx--) return Text(path.str() + from, path.length() - from, path.pgm());
+            int16_t to = path.indexOf('/', from);
+            if (to < 0) break;
+            from = to;
+        }
+        return Text(path.str() + path.length(), 0, path.pgm());
+    }
+};
+
+// таблица маршрутов. Статичные пути ищутся по хэшу бинарным поиском,
+// пути с параметрами ":name" и окончанием "*" сравниваются по сегментам. При совпадении хэшей сравнивается текст
+template <typename cb_t>
+class Router : public RouterBase {
+   public:
+    struct Segment {
+        Text text;
+        size_t hash;
+        bool param;     // ":name" - любое значение
+    };
+
+    struct Route {
+        Text method;
+        Text path;
+        size_t mhash;
+        size_t hash;
+        Segment* segs;
+        uint8_t nsegs;
+        bool wildcard;
+        cb_t cb;
+    };
+
+    ~Router() {
+        for (uint8_t i = 0; i < _len; i++) {
+            delete[] _routes[i]->segs;
+            delete _routes[i];
+        }
+        free(_routes);
+    }
+
+    // добавить маршрут. method - пустой для любого метода. Строки должны существовать всё время работы.
+    // Вернёт false, если в маршруте с параметрами больше HS_ROUTE_DEPTH сегментов (не считая "*" в конце) или "*" не в конце
+    bool add(const Text& method, const Text& path, cb_t cb) {
+        if (!path.length() || _len == 0xff) return false;
+
+        // весь путь: количество сегментов, параметры и "*" в конце
+        uint16_t n = 0;
+        bool dynamic = false, wildcard = false;
+        Text rest = path, seg;
+        while (split(rest, &seg, 1)) {
+            if (wildcard) return false;
+            n++;
+            wildcard = _isWildcard(seg);
+            if (seg[0] == ':' || wildcard) dynamic = true;
+            rest = tail(rest, 1);
+        }
+        if (wildcard) n--;
+        if (dynamic && n > HS_ROUTE_DEPTH) return false;
+
+        Route** routes = (Route**)realloc(_routes, (_len + 1) * sizeof(Route*));
+        if (!routes) return false;
+        _routes = routes;
+
+        Route* r = new Route{method, path, method.hash(), 0, nullptr, 0, false, cb};
+        if (dynamic) {
+            Text segs[HS_ROUTE_DEPTH];
+            split(path, segs, n);
+            r->wildcard = wildcard;
+            r->nsegs = n;
+            r->segs = new Segment[n ? n : 1];
+            for (uint8_t i = 0; i < n; i++) {
+                r->segs[i] = Segment{segs[i], segs[i].hash(), segs[i][0] == ':'};
+            }
+            _routes[_len++] = r;  // порядок добавления сохраняется
+        } else {
+            r->hash = path.hash();
+            uint8_t pos = _static;  // статичные маршруты отсортированы по хэшу в начале списка
+            while (pos && _routes[pos - 1]->hash > r->hash) pos--;
+            memmove(_routes + pos + 1, _routes + pos, (_len - pos) * sizeof(Route*));
+            _routes[pos] = r;
+            _static++;
+            _len++;
+        }
+        return true;
+    }
+
+    // найти маршрут для метода и пути (без параметров)
+    const Route* match(const Text& method, const Text& path) const {
+        if (!_len) return nullptr;
+        size_t mhash = method.hash();
+
+        if (_static) {
+            size_t hash = path.hash();
+            int16_t lo = 0, hi = _static - 1;
+            while (lo <= hi) {
+                int16_t mid = (lo + hi) / 2;
+                size_t h = _routes[mid]->hash;
+                if (h < hash) lo = mid + 1;
+                else if (h > hash) hi = mid - 1;
+                else {
+                    while (mid && _routes[mid - 1]->hash == hash) mid--;
+                    for (; mid < _static && _routes[mid]->hash == hash; mid++) {
+                        const Route* r = _routes[mid];
+                        if (_method(r, method, mhash) && r->path == path) return r;
+                    }
+                    break;
+                }
+            }
+        }
+
+        if (_static == _len) return nullptr;
+
+        Text segs[HS_ROUTE_DEPTH + 1];
+        uint8_t n = split(path, segs, HS_ROUTE_DEPTH + 1);
+        size_t hashes[HS_ROUTE_DEPTH];
+        for (uint8_t i = 0; i < n && i < HS_ROUTE_DEPTH; i++) hashes[i] = segs[i].hash();
+
+        for (uint8_t i = _static; i < _len; i++) {
+            const Route* r = _routes[i];
+            if (!_method(r, method, mhash)) continue;
+            if (r->wildcard ? (n < r->nsegs) : (n != r->nsegs)) continue;
+
+            uint8_t s = 0;
+            for (; s < r->nsegs; s++) {
+                const Segment& seg = r->segs[s];
+                if (!seg.param && (seg.hash != hashes[s] || !(seg.text == segs[s]))) break;
+            }
+            if (s == r->nsegs) return r;
+        }
+        return nullptr;
+    }
+
+    // количество маршрутов
+    uint8_t length() const {
+        return _len;
+    }
+
+   private:
+    Route** _routes = nullptr;
+    uint8_t _len = 0;
+    uint8_t _static = 0;
+
+    // метод подходит маршруту: любой или совпал по хэшу и тексту
+    static bool _method(const Route* r, const Text& method, size_t mhash) {
+        return !r->method.length() || (r->mhash == mhash && r->method == method);
+    }
+
+    static bool _isWildcard(const Text& seg) {
+        return seg.length() == 1 && seg[0] == '*';
+    }
+};
+
+}  // namespace ghttp
@@ -1,11 +1,19 @@
 #pragma once
 #include "ServerBase.h"
 
-#define GS_CLIENT_TOUT 1500
+#define GS_CLIENT_TOUT HS_CLIENT_TOUT
+
+#ifndef GS_MAX_CLIENTS
+#ifdef __AVR__
+#define GS_MAX_CLIENTS 1        // макс. количество одновременных подключений
+#else
+#define GS_MAX_CLIENTS 4        // макс. количество одновременных подключений
+#endif
+#endif
 
 namespace ghttp {
 
-template <typename server_t, typename client_t>
+template <typename server_t, typename client_t, uint8_t max_clients = GS_MAX_CLIENTS>
 class Server : public ServerBase {
    public:
     Server(uint16_t port) : server(port) {}
@@ -15,18 +23,63 @@ class Server : public ServerBase {
         server.begin();
     }
 
-    // вызывать в loop
+    // вызывать в loop. Обрабатывает все подключения без блокировки
     void tick(HeadersCollector* collector = nullptr) {
-        client_t client = server.accept();
-        if (client) {
-            client.Stream::setTimeout(GS_CLIENT_TOUT);
-            handleRequest(client, collector);
+        for (Slot& slot : _slots) {
+            if (!slot.conn.active()) continue;
+            GHTTP_ESP_YIELD();
+            if (!tickConnection(slot.client, slot.conn, collector)) _close(slot);
+        }
+
+        // новый клиент принимается только при наличии свободного слота, остальные ждут в очереди сервера.
+        // Если все слоты заняты - новый клиент вытесняет простаивающее keep-alive подключение.
+        // Слот выбирается после обработки: подключение могло начать запрос или закрыться
+        Slot* free = nullptr;
+        Slot* idle = nullptr;
+        for (Slot& slot : _slots) {
+            if (!slot.conn.active()) {
+                free = &slot;
+                break;
+            }
+            if (slot.conn.idle() && !idle) idle = &slot;
+        }
+        if (!free) free = idle;
+        if (free) {
+            client_t client = server.accept();
+            if (client) {
+                if (free->conn.active()) _close(*free);
+                free->client = client;
+                free->client.Stream::setTimeout(GS_CLIENT_TOUT);
+                _noDelay(free->client, 0);
+                free->conn.begin();
+                GHTTP_METRIC(_metrics.connections++;)
+            }
         }
     }
 
     server_t server;
 
    private:
+    struct Slot {
+        client_t client;
+        Connection conn;
+    };
+
+    Slot _slots[max_clients];
+
+    // ответ копится в буфере вывода сервера, поэтому алгоритм Нейгла только задерживает последний пакет
+    template <typename T>
+    static auto _noDelay(T& client, int) -> decltype(client.setNoDelay(true), void()) {
+        client.setNoDelay(true);
+    }
+    template <typename T>
+    static void _noDelay(T&, long) {}
+
+    void _close(Slot& slot) {
+        slot.client.stop();
+        slot.client = client_t();
+        slot.conn.end();
+    }
 };
 
-}
\ No newline at end of file
+}  // namespace ghttp
@@ -3,9 +3,18 @@
 #include <Client.h>
 #include <StringUtils.h>
 
+#include "BlockPool.h"
+#include "Events.h"
+#include "Gzip.h"
 #include "HeadersParser.h"
+#include "Metrics.h"
+#include "Multipart.h"
+#include "OutputBuffer.h"
+#include "Params.h"
+#include "Router.h"
 #include "StreamReader.h"
 #include "StreamWriter.h"
+#include "WebSocket.h"
 #include "cfg.h"
 
 #ifndef __AVR__
@@ -19,91 +28,221 @@
 #define HS_BLOCK_SIZE 256       // размер блока выгрузки из файла и PROGMEM
 #define HS_FLUSH_BLOCK 64       // блок очистки
 #define HS_CACHE_PRD "604800"   // период кеширования
+#define HS_CLIENT_TOUT 1500     // таймаут неактивного подключения
+
+#ifndef HS_KEEPALIVE_TOUT
+#define HS_KEEPALIVE_TOUT 5000  // таймаут ожидания следующего запроса в keep-alive подключении
+#endif
+
+#ifndef HS_KEEPALIVE_MAX
+#define HS_KEEPALIVE_MAX 100    // макс. количество запросов в одном keep-alive подключении
+#endif
+
+#ifndef HS_LINE_SIZE
+#ifdef __AVR__
+#define HS_LINE_SIZE 128        // буфер строки запроса и строки хэдера. Длиннее - ответ 414 или 431
+#else
+#define HS_LINE_SIZE 512        // буфер строки запроса и строки хэдера. Длиннее - ответ 414 или 431
+#endif
+#endif
+
+#ifndef HS_HEADERS_SIZE
+#ifdef __AVR__
+#define HS_HEADERS_SIZE 128     // буфер хэдеров ответа
+#else
+#define HS_HEADERS_SIZE 384     // буфер хэдеров ответа
+#endif
+#endif
+
+#ifndef HS_OUT_SIZE
+#ifdef __AVR__
+#define HS_OUT_SIZE 64          // буфер вывода: хэдеры и мелкие данные ответа отправляются одним пакетом. 0 - отключить
+#else
+#define HS_OUT_SIZE 512         // буфер вывода: хэдеры и мелкие данные ответа отправляются одним пакетом. 0 - отключить
+#endif
+#endif
+
+#ifndef HS_BODY_PRELOAD
+#define HS_BODY_PRELOAD 512     // дождаться столько байт тела запроса перед вызовом обработчика. Остаток тела читается в обработчике с ожиданием
+#endif
+
+#ifndef HS_EVENTS_PING
+#define HS_EVENTS_PING 15000    // период пустого события подписчикам Server-Sent Events без событий. Подписчик, не принимающий данные дольше периода, отключается
+#endif
 
 namespace ghttp {
 
+// текст статуса ответа по коду
+inline const __FlashStringHelper* reasonPhrase(uint16_t code) {
+    switch (code) {
+        case 100: return F("Continue");
+        case 101: return F("Switching Protocols");
+        case 200: return F("OK");
+        case 201: return F("Created");
+        case 202: return F("Accepted");
+        case 204: return F("No Content");
+        case 206: return F("Partial Content");
+        case 301: return F("Moved Permanently");
+        case 302: return F("Found");
+        case 303: return F("See Other");
+        case 304: return F("Not Modified");
+        case 307: return F("Temporary Redirect");
+        case 308: return F("Permanent Redirect");
+        case 400: return F("Bad Request");
+        case 401: return F("Unauthorized");
+        case 403: return F("Forbidden");
+        case 404: return F("Not Found");
+        case 405: return F("Method Not Allowed");
+        case 408: return F("Request Timeout");
+        case 409: return F("Conflict");
+        case 411: return F("Length Required");
+        case 413: return F("Payload Too Large");
+        case 414: return F("URI Too Long");
+        case 415: return F("Unsupported Media Type");
+        case 416: return F("Range Not Satisfiable");
+        case 426: return F("Upgrade Required");
+        case 429: return F("Too Many Requests");
+        case 431: return F("Request Header Fields Too Large");
+        case 500: return F("Internal Server Error");
+        case 501: return F("Not Implemented");
+        case 502: return F("Bad Gateway");
+        case 503: return F("Service Unavailable");
+        case 504: return F("Gateway Timeout");
+    }
+    if (code < 300) return F("OK");
+    if (code < 400) return F("Redirect");
+    if (code < 500) return F("Client Error");
+    return F("Server Error");
+}
+
 class ServerBase {
    public:
-    class Headers {
+    // билдер хэдеров ответа. Пишет в буфер фиксированного размера, при переполнении продолжает в String
+    class Headers : public Print {
         friend class ServerBase;
-        Headers() {
-            s.reserve(200);
-        }
+        Headers() {}
         void begin(uint16_t code) {
             if (_started) return;
             _started = true;
-            s += F("HTTP/1.1 ");
-            s += code;
-            s += (code == 200) ? F(" OK\r\n") : F(" ERROR\r\n");
+            GHTTP_METRIC(_code = code;)
+            print(F("HTTP/1.1 "));
+            print(code);
+            print(' ');
+            print(reasonPhrase(code));
+            clrf();
         }
         void cache(bool enabled) {
+            if (_cache) return;
             checkStart();
+            _cache = true;
             if (enabled) {
-                s += F("Cache-Control: max-age=" HS_CACHE_PRD "\r\n");
+                print(F("Cache-Control: max-age=" HS_CACHE_PRD "\r\n"));
             } else {
-                s += F(
+                print(F(
                     "Cache-Control: no-cache, no-store, must-revalidate\r\n"
                     "Pragma: no-cache\r\n"
-                    "Expires: 0\r\n");
+                    "Expires: 0\r\n"));
             }
         }
         void type(const Text& t) {
             checkStart();
-            s += F("Content-Type: ");
-            if (t) t.addString(s);
-            else s += F("text/plain");
+            print(F("Content-Type: "));
+            if (t) print(t);
+            else print(F("text/plain"));
             clrf();
         }
+        void cache(uint32_t maxAge) {
+            checkStart();
+            _cache = true;
+            if (maxAge) {
+                print(F("Cache-Control: max-age="));
+                print(maxAge);
+                clrf();
+            } else {
+                print(F("Cache-Control: no-cache\r\n"));
+            }
+        }
         void gzip(bool enabled) {
             checkStart();
-            if (enabled) s += F("Content-Encoding: gzip\r\n");
+            if (enabled) print(F("Content-Encoding: gzip\r\n"));
         }
         void cors(bool use = true) {
             checkStart();
             if (use) {
-                s += F(
+                print(F(
                     "Access-Control-Allow-Origin:*\r\n"
                     "Access-Control-Allow-Private-Network: true\r\n"
-                    "Access-Control-Allow-Methods:*\r\n");
+                    "Access-Control-Allow-Methods:*\r\n"));
             }
         }
         void length(size_t len) {
             checkStart();
-            s += F("Content-Length: ");
-            s += len;
+            print(F("Content-Length: "));
+            print(len);
             clrf();
+            _length = true;
         }
 
        public:
         // код ответа сервера
         Headers(uint16_t code) {
-            s.reserve(200);
             begin(code);
         }
 
         // добавить хэдер
         void add(const Text& name, const Text& value) {
             checkStart();
-            name.addString(s);
-            s += F(": ");
-            value.addString(s);
+            print(name);
+            print(F(": "));
+            print(value);
             clrf();
         }
 
+        using Print::write;
+        size_t write(uint8_t data) {
+            return write(&data, 1);
+        }
+        size_t write(const uint8_t* data, size_t len) {
+            size_t n = min(len, space());
+            memcpy(_buf + _len, data, n);
+            _len += n;
+            if (n == len) return n;
+            return _over.concat((const char*)data + n, len - n) ? len : n;
+        }
+
        private:
-        String s;
+        char _buf[HS_HEADERS_SIZE];
+        uint16_t _len = 0;
+        String _over;
         bool _started = false;
+        bool _length = false;
+        bool _cache = false;
+        GHTTP_METRIC(uint16_t _code = 0;)
+
         void clrf() {
-            s += F("\r\n");
+            print(F("\r\n"));
         }
         void checkStart() {
             if (!_started) begin(200);
         }
+
+        // свободное место в буфере
+        size_t space() const {
+            return _over.length() ? 0 : HS_HEADERS_SIZE - _len;
+        }
+
+        // отправить содержимое и очистить. Данные из буфера уходят одним вызовом write
+        void flushTo(Print& p) {
+            if (_len) p.write((const uint8_t*)_buf, _len);
+            if (_over.length()) p.write((const uint8_t*)_over.c_str(), _over.length());
+            _len = 0;
+            _over = String();
+        }
     };
 
     class Request {
        public:
-        Request(const Text& method, const Text& url, Stream* stream, size_t len, bool chunked = false) : _reader(stream, len, chunked), _method(method), _url(url) {
+        Request(const Text& method, const Text& url, StreamReader& reader, const Text& route = Text(), const Text& type = Text(), Params* params = nullptr, ServerBase* server = nullptr) : _reader(&reader), _params(params), _server(server), _method(method), _url(url), _route(route), _type(type) {
             _q = _url.indexOf('?');
         }
 
@@ -122,80 +261,271 @@ class ServerBase {
             return (_q > 0) ? _url.substring(0, _q) : _url;
         }
 
-        // получить значение параметра по ключу
+        // получить значение параметра по ключу. Параметры запроса разбираются и декодируются один раз при первом обращении.
+        // Параметр без значения вернёт валидную пустую строку
         Text param(const Text& key) const {
-            if (_q < 0) return Text();
+            return _params ? _params->get(key) : Text();
+        }
 
-            Text params = _url.substring(_q + 1);
-            int p = 0;
+        // индекс параметров запроса (и тела формы после form()) для перебора
+        Params& params() {
+            return *_params;
+        }
 
-            while (1) {
-                p = params.indexOf(key, p);
-                if (p < 0) return Text();
+        // прочитать тело application/x-www-form-urlencoded до HS_FORM_SIZE, его поля станут доступны в param().
+        // Вернёт false, если тело другого типа или не поместилось в буфер
+        bool form() {
+            return _params && _type.startsWith(F("application/x-www-form-urlencoded")) && _params->readForm(*_reader);
+        }
 
-                p += key.length();
-                if (p == params.length() || params[p] == '&') {
-                    return Text("", 0);
-                }
-                if (params[p] == '=') {
-                    p++;
-                    break;
+        // шаблон маршрута, по которому вызван обработчик
+        const Text& route() const {
+            return _route;
+        }
+
+        // получить значение параметра пути по имени из маршрута ("/led/:id" -> pathArg("id"))
+        Text pathArg(const Text& name) const {
+            Text segs[HS_ROUTE_DEPTH];
+            uint8_t n = RouterBase::split(_route, segs, HS_ROUTE_DEPTH);
+            for (uint8_t i = 0; i < n; i++) {
+                if (segs[i][0] == ':' && segs[i].length() == name.length() + 1 && segs[i].substring(1) == name) {
+                    Text parts[HS_ROUTE_DEPTH];
+                    Text p = path();
+                    return (i < RouterBase::split(p, parts, HS_ROUTE_DEPTH)) ? parts[i] : Text();
                 }
             }
-            int end = params.indexOf('&', p);
-            if (end < 0) end = params.length();
-            return params.substring(p, end);
+            return Text();
         }
 
-        // получить тело запроса. Может выводиться в Print
+        // получить часть пути, совпавшую с "*" в маршруте ("/files/*" -> "dir/file.txt")
+        Text pathTail() const {
+            Text segs[HS_ROUTE_DEPTH + 1];
+            uint8_t n = RouterBase::split(_route, segs, HS_ROUTE_DEPTH + 1);
+            if (!n || segs[n - 1].length() != 1 || segs[n - 1][0] != '*') return Text();
+            return RouterBase::tail(path(), n - 1);
+        }
+
+        // тип содержимого тела запроса (Content-Type)
+        const Text& contentType() const {
+            return _type;
+        }
+
+        // получить тело запроса. Может выводиться в Print. У multipart/form-data с известной длиной - содержимое
+        // первой части, закрывающая граница не читается и подключение закрывается после ответа
         StreamReader& body() {
-            return _reader;
+            return (_server && _type.startsWith(F("multipart"))) ? _server->_firstPart() : *_reader;
+        }
+
+        // прочитать тело multipart/form-data. Обработчик вызывается для каждой порции данных каждой части.
+        // Вернёт true, если тело разобрано до конца. Не работает после body()
+        bool multipart(Multipart::PartCallback cb) {
+            if (_server && _server->_bodyPart) return false;
+            Multipart* mp = new Multipart(_type);  // ~0.5 кБ таблиц, не на стеке
+            bool ok = *mp && mp->read(*_reader, cb);
+            delete mp;
+            return ok;
         }
 
        private:
-        StreamReader _reader;
+        StreamReader* _reader;
+        Params* _params;
+        ServerBase* _server;
         const Text _method;
         const Text _url;
+        const Text _route;
+        const Text _type;
         int16_t _q = -1;
     };
 
+    // состояние асинхронного подключения
+    class Connection {
+        friend class ServerBase;
+
+       public:
+        // подключение активно
+        bool active() const {
+            return _state != State::Idle;
+        }
+
+        // keep-alive подключение ожидает следующий запрос
+        bool idle() const {
+            return _state == State::Line && _headers.empty() && _count;
+        }
+
+        // подключение - подписчик Server-Sent Events
+        bool events() const {
+            return _state == State::Events;
+        }
+
+        // подключение переведено на WebSocket
+        bool webSocket() const {
+            return _state == State::WebSocket;
+        }
+
+        // начать работу с новым клиентом
+        void begin() {
+            _reset();
+            _count = 0;
+            _state = State::Line;
+            GHTTP_METRIC(_m.accept = micros();)
+        }
+
+        // освободить подключение
+        void end() {
+            _reset();
+            _state = State::Idle;
+        }
+
+       private:
+        enum class State : uint8_t {
+            Idle,
+            Line,
+            Body,
+            Response,
+            Drain,
+            Events,
+            WebSocket,
+        };
+
+        State _state = State::Idle;
+        char _buf[HS_LINE_SIZE];
+        uint16_t _count = 0;
+        bool _keep = false;
+        uint32_t _tmr = 0;
+        size_t _drain = 0;      // непрочитанное тело запроса, пропускается без ожидания
+        uint32_t _evPos = 0;    // позиция в очереди событий
+        bool _evPartial = false;
+        HeadersParser _headers;
+        StreamWriter _writer;
+        ghttp::WebSocket _ws;
+#ifdef FS_H
+        File _file;
+#endif
+        GHTTP_METRIC(RequestMetrics _m;)
+
+        void _reset() {
+            _keep = false;
+            _tmr = millis();
+            _drain = 0;
+            _evPos = 0;
+            _evPartial = false;
+            _headers = HeadersParser(_buf, HS_LINE_SIZE);
+            _writer = StreamWriter();
+            GHTTP_METRIC(_m = RequestMetrics();)
+#ifdef FS_H
+            _file = File();
+#endif
+        }
+    };
+
 #ifdef __AVR__
     typedef void (*RequestCallback)(Request req);
 #else
     typedef std::function<void(Request req)> RequestCallback;
 #endif
 
+#ifdef GHTTP_METRICS
+#ifdef __AVR__
+    typedef void (*MetricsCallback)(const RequestMetrics& m);
+#else
+    typedef std::function<void(const RequestMetrics& m)> MetricsCallback;
+#endif
+#endif
+
     // ==================== SERVER ====================
    public:
+    ~ServerBase() {
+#ifdef FS_H
+        while (_static) {
+            Static* next = _static->next;
+            delete _static;
+            _static = next;
+        }
+#endif
+        delete _gz;
+        delete _events;
+        delete _wsQueue;
+    }
+
     // начать ответ. В Headers можно указать кастомные хэдеры. Отправка через send/print
     void beginResponse(Headers& resp) {
-        _beginResponse(resp, false);
+        if (!_clientp || _respStarted) return;
+        _flush();
+        _resp = resp;
+        _start(200);
     }
 
     // начать ответ. Отправка через send/print
     void beginResponse(uint16_t code = 200) {
-        Headers resp(code);
-        _beginResponse(resp, false);
+        if (!_clientp || _respStarted) return;
+        _flush();
+        _start(code);
     }
 
-    // доступ к клиенту для отправки
+    // доступ к клиенту для отправки. Накопленные хэдеры и данные будут отправлены.
+    // После send/print без указания длины ответ идёт в формате chunked - писать в клиента напрямую нельзя
     ::Client* client() {
+        if (_clientp) {
+            _flushHeaders();
+            _out.flush();
+        }
         return _clientp;
     }
 
-    // подключить обработчик запроса
+    // подключить обработчик запроса. Вызывается, если запрос не совпал ни с одним маршрутом
     void onRequest(RequestCallback callback) {
         _req_cb = callback;
     }
 
+#ifdef GHTTP_METRICS
+    // подключить обработчик метрик. Вызывается для каждого запроса после отправки последнего байта ответа
+    void onMetrics(MetricsCallback callback) {
+        _metrics_cb = callback;
+    }
+
+    // накопительные счётчики сервера
+    const Metrics& metrics() const {
+        return _metrics;
+    }
+
+    // отдавать счётчики в текстовом формате Prometheus по GET запросу на path. Проверяется до маршрутов
+    void serveMetrics(const Text& path = "/metrics") {
+        _metricsPath = path;
+    }
+#endif
+
+    // подключить обработчик к пути для любого метода. Путь: "/status", "/led/:id", "/files/*"
+    bool on(const Text& path, RequestCallback callback) {
+        return _router.add(Text(), path, callback);
+    }
+
+    // подключить обработчик к методу и пути. Путь: "/status", "/led/:id", "/files/*"
+    bool on(const Text& method, const Text& path, RequestCallback callback) {
+        return _router.add(method, path, callback);
+    }
+
+#ifdef FS_H
+    // раздавать файлы из папки path файловой системы fs по адресу uri ("/", "/static"). Проверяется после маршрутов.
+    // maxAge - время кеширования в секундах, 0 - браузер проверяет файл при каждом запросе (ответ 304 по ETag)
+    bool serveStatic(const Text& uri, fs::FS& fs, const Text& path = "/", uint32_t maxAge = 0) {
+        Static* st = new Static{uri, path, &fs, maxAge, nullptr};
+        if (!st) return false;
+        Static** p = &_static;
+        while (*p) p = &(*p)->next;
+        *p = st;
+        return true;
+    }
+#endif
+
     // отправить клиенту и завершить сеанс. Должно быть единственным ответом, использовать без beginResponse
     void sendSingle(const uint8_t* data, size_t len, uint16_t code = 200, Text type = Text()) {
         if (!_clientp || _respStarted) return;
 
-        Headers resp(code);
-        resp.type(type);
-        resp.length(len);
-        _beginResponse(resp, true);
+        _flush();
+        _start(code);
+        _resp.type(type);
+        _resp.length(len);
+        _endHeaders(true);
         _send(data, len);
         _clientp = nullptr;
     }
@@ -210,10 +540,11 @@ class ServerBase {
         if (!_clientp) return;
 
         if (!_respStarted) {
-            Headers resp(code);
-            resp.type(type);
-            _beginResponse(resp, true);
+            _flush();
+            _start(code);
+            _resp.type(type);
         }
+        if (!_contentBegin) _endHeaders(false);
         _send(data, len);
     }
 
@@ -229,10 +560,7 @@ class ServerBase {
         if (!_respStarted) {
             send(data, len, 200);
         } else {
-            if (!_contentBegin) {
-                _contentBegin = true;
-                _clientp->println();
-            }
+            if (!_contentBegin) _endHeaders(false);
             _send(data, len);
         }
     }
@@ -247,10 +575,12 @@ class ServerBase {
         if (!_clientp) return;
 
         if (!_respStarted) {
-            Headers resp(200);
-            _beginResponse(resp, true);
+            _flush();
+            _start(200);
         }
-        _clientp->print(p);
+        if (!_contentBegin) _endHeaders(false);
+        _flushHeaders();
+        _output().print(p);
     }
 
     // отправить клиенту код. Должно быть единственным ответом
@@ -259,10 +589,12 @@ class ServerBase {
 
         _flush();
         if (!_respStarted) {
-            Headers resp(code);
-            _beginResponse(resp, true);
+            _start(code);
+            if (code != 204 && code != 304) _resp.length(0);
+            else _resp._length = true;  // ответ без тела
         }
-        _respStarted = true;
+        if (!_contentBegin) _endHeaders(_resp._length);
+        _flushHeaders();
         _clientp = nullptr;
     }
 
@@ -270,8 +602,14 @@ class ServerBase {
     // отправить файл
     void sendFile(File& file, Text type = Text(), bool cache = false, bool gzip = false) {
         if (!_clientp) return;
-        StreamWriter writer(&file, file.size());
-        _sendFile(writer, type, cache, gzip);
+        if (_conn) {
+            _conn->_file = file;
+            StreamWriter writer(&_conn->_file);
+            _sendFile(writer, type, cache, gzip, true);
+        } else {
+            StreamWriter writer(&file);
+            _sendFile(writer, type, cache, gzip);
+        }
     }
 #endif
 
@@ -279,7 +617,7 @@ class ServerBase {
     void sendFile(const Text& text, Text type = Text(), bool cache = false) {
         if (!_clientp) return;
         StreamWriter writer(text.str(), text.length(), text.pgm());
-        _sendFile(writer, type, cache, false);
+        _sendFile(writer, type, cache, false, text.pgm());
     }
 
     // отправить файл из буфера
@@ -293,19 +631,135 @@ class ServerBase {
     void sendFile_P(const uint8_t* buf, size_t len, Text type = Text(), bool cache = false, bool gzip = false) {
         if (!_clientp) return;
         StreamWriter writer(buf, len, true);
-        _sendFile(writer, type, cache, gzip);
+        _sendFile(writer, type, cache, gzip, true);
     }
 
     // отправить файл-строку из PROGMEM
     void sendFile_P(const char* pstr, Text type = Text(), bool cache = false) {
         if (!_clientp) return;
         StreamWriter writer(pstr, strlen_P(pstr), true);
-        _sendFile(writer, type, cache, false);
+        _sendFile(writer, type, cache, false, true);
+    }
+
+    // перевести запрос в поток Server-Sent Events (text/event-stream): подключение остаётся открытым и получает события
+    // sendEvent. Только в асинхронном режиме (Server::tick), использовать без beginResponse. retry - интервал
+    // переподключения браузера в мс, 0 - по умолчанию. Вернёт false, если поток не открыт
+    bool beginEvents(uint32_t retry = 0) {
+        if (!_clientp || _respStarted || !_conn) return false;
+        if (!_events && !(_events = new EventQueue())) return false;
+
+        _flush();
+        _keepAlive = false;
+        _start(200);
+        _resp.type(F("text/event-stream"));
+        _resp.cache(false);
+        _endHeaders(true);  // без chunked и сжатия, поток до закрытия подключения
+        _flushHeaders();
+        if (retry) {
+            _out.print(F("retry: "));
+            _out.print(retry);
+            _out.print(F("\n\n"));
+        }
+        _conn->_state = Connection::State::Events;
+        _conn->_evPos = _events->end();
+        _evClients++;
+        _clientp = nullptr;
+        return true;
+    }
+
+    // отправить событие всем подписчикам. Событие сериализуется один раз в общую очередь (HS_EVENTS_BUFFER), подписчики
+    // получают его в Server::tick по мере освобождения буфера отправки. Вернёт false, если нет подписчиков или событие больше очереди
+    bool sendEvent(const Text& data, const Text& event = Text(), const Text& id = Text()) {
+        return _evClients && _events->add(data, event, id);
+    }
+
+    // количество подписчиков Server-Sent Events
+    uint8_t eventClients() {
+        return _evClients;
+    }
+
+    // что делать с подписчиком, события которого вытеснены из очереди до отправки (умолч. Skip - пропустить)
+    void setEventsDrop(EventQueue::Drop drop) {
+        _evDrop = drop;
+    }
+
+    // перевести запрос с Upgrade: websocket на WebSocket: подключение остаётся открытым, входящие сообщения и события
+    // приходят в onWebSocket. Только в асинхронном режиме (Server::tick). Вернёт false, если запрос не WebSocket:
+    // без Upgrade: websocket, Connection: upgrade или Sec-WebSocket-Key отвечает 400, на версию протокола,
+    // отличную от 13, - 426 с Sec-WebSocket-Version: 13
+    bool beginWebSocket() {
+        if (!_clientp || _respStarted || !_conn) return false;
+        if (!_wsKey.length()) {  // не GET с Upgrade: websocket, Connection: upgrade и Sec-WebSocket-Key
+            _flush();
+            send(400);
+            return false;
+        }
+        if (_wsVersion != 13) {
+            _flush();
+            _resp.begin(426);
+            _resp.add(F("Sec-WebSocket-Version"), F("13"));
+            send(426);
+            return false;
+        }
+        if (!_wsQueue && !(_wsQueue = new EventQueue())) return false;
+
+        char accept[29];
+        WebSocket::accept(_wsKey, accept);
+        _keepAlive = false;
+        _resp.begin(101);
+        _resp.print(F("Upgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: "));
+        _resp.print(accept);
+        _resp.print(F("\r\n\r\n"));
+        _respStarted = _contentBegin = true;
+        _flushHeaders();
+
+        _conn->_state = Connection::State::WebSocket;
+        _conn->_evPos = _wsQueue->end();
+        _conn->_ws._begin(*_clientp, ++_wsId);
+        _conn->_ws._next = _wsList;
+        _wsList = &_conn->_ws;
+        _wsClients++;
+        _clientp = nullptr;
+        return true;
+    }
+
+    // подключить обработчик WebSocket: открытие (event() Open), порции сообщений (Message) и закрытие (Close).
+    // data - данные в буфере чтения, действительны только в обработчике. Длинное сообщение приходит порциями до HS_WS_BLOCK
+    void onWebSocket(WebSocket::Callback callback) {
+        _ws_cb = callback;
+    }
+
+    // отправить сообщение всем WebSocket подключениям. Кадр сериализуется один раз в общую очередь (HS_EVENTS_BUFFER),
+    // подключения получают его в Server::tick. Вернёт false, если нет подключений или кадр больше очереди
+    bool sendWebSocket(const uint8_t* data, size_t len, bool binary = false) {
+        if (!_wsClients) return false;
+        uint8_t head[10];
+        uint8_t hlen = WebSocket::header(head, binary ? WebSocket::OpBinary : WebSocket::OpText, len);
+        return _wsQueue->add(head, hlen, data, len);
+    }
+
+    // отправить текст всем WebSocket подключениям
+    bool sendWebSocket(const Text& text) {
+        return sendWebSocket((const uint8_t*)text.str(), text.length());
+    }
+
+    // WebSocket подключение по номеру id(). nullptr - подключение закрыто
+    WebSocket* webSocket(uint16_t id) {
+        for (WebSocket* ws = _wsList; ws; ws = ws->_next) {
+            if (ws->id() == id) return ws;
+        }
+        return nullptr;
+    }
+
+    // количество WebSocket подключений
+    uint8_t webSocketClients() {
+        return _wsClients;
     }
 
     // пометить запрос как выполненный
     void handle() {
         _respStarted = true;
+        _keepAlive = false;
     }
 
     // использовать CORS хэдеры (умолч. включено)
@@ -313,6 +767,22 @@ class ServerBase {
         _cors = use;
     }
 
+    // использовать keep-alive подключения (умолч. включено)
+    void useKeepAlive(bool use) {
+        _keepAliveUse = use;
+    }
+
+    // отправлять ответы без длины в формате chunked, чтобы сохранить keep-alive подключение (умолч. включено)
+    void useChunked(bool use) {
+        _chunkedUse = use;
+    }
+
+    // сжимать gzip ответы без длины (send, print), если клиент принимает gzip (умолч. выключено).
+    // Сжатие выполняется на лету, буфер сжатия (~2 окна GHTTP_GZIP_WINDOW) выделяется при первом использовании
+    void useGzip(bool use) {
+        _gzipUse = use;
+    }
+
     // получить mime тип файла по его пути
     const __FlashStringHelper* getMime(const Text& path) {
         int16_t pos = path.lastIndexOf('.');
@@ -326,11 +796,15 @@ class ServerBase {
                 case su::SH("gz"): return F("application/gzip");
                 case su::SH("gif"): return F("image/gif");
                 case su::SH("html"): return F("text/html");
+                case su::SH("ico"): return F("image/x-icon");
                 case su::SH("js"): return F("text/javascript");
                 case su::SH("json"): return F("application/json");
                 case su::SH("png"): return F("image/png");
                 case su::SH("svg"): return F("image/svg+xml");
                 case su::SH("wav"): return F("audio/wav");
+                case su::SH("webp"): return F("image/webp");
+                case su::SH("woff"): return F("font/woff");
+                case su::SH("woff2"): return F("font/woff2");
                 case su::SH("xml"): return F("application/xml");
                 case su::SH("jpeg"):
                 case su::SH("jpg"):
@@ -340,98 +814,670 @@ class ServerBase {
         return F("text/plain");
     }
 
-    // обработать запрос
+    // обработать запрос (блокирующий режим)
     void handleRequest(::Client& client, HeadersCollector* collector = nullptr) {
-        String lineStr = client.readStringUntil('\n');
+        char buf[HS_LINE_SIZE];
+        HeadersParser headers(buf, HS_LINE_SIZE);
+        GHTTP_METRIC(RequestMetrics m; m.accept = micros(); _metrics.connections++;)
+        headers.read(client, collector);
+        GHTTP_METRIC(_metricsHeaders(m, headers);)
+
         Text lines[3];
-        size_t n = Text(lineStr).split(lines, 3, ' ');
-        if (n != 3) return;
+        if (headers.startLine().split(lines, 3, ' ') != 3) {
+            GHTTP_METRIC(_metrics.parseErrors++;)
+            return;
+        }
+        GHTTP_METRIC(_rm = &m;)
+        _handle(client, lines[0], lines[1], lines[2], headers);
+        GHTTP_METRIC(_metricsEnd();)
+    }
 
-        HeadersParser headers(client, collector);
+    // обработать подключение асинхронно, вызывать в loop. Вернёт false, если подключение нужно закрыть
+    bool tickConnection(::Client& client, Connection& conn, HeadersCollector* collector = nullptr) {
+        switch (conn._state) {
+            case Connection::State::Idle:
+                return false;
 
-        if (!headers || !_req_cb) return send(400);
+            case Connection::State::Line:
+                if (client.available()) {
+                    conn._tmr = millis();
+                    GHTTP_METRIC(if (!conn._m.accept) conn._m.accept = micros();)
+                }
+                if (!conn._headers.parse(client, collector)) break;
+                GHTTP_METRIC(_metricsHeaders(conn._m, conn._headers);)
+                if (!conn._headers) {
+                    GHTTP_METRIC(_metrics.parseErrors++; _rm = &conn._m;)
+                    return _reject(client, _parseError(conn._headers));
+                }
+                conn._state = Connection::State::Body;
+                // fall through
 
-        _clientp = &client;
-        _respStarted = false;
-        _contentBegin = false;
+            case Connection::State::Body:
+                if (!conn._headers.chunked && conn._headers.length && (size_t)client.available() < min(conn._headers.length, (size_t)HS_BODY_PRELOAD)) break;
+                {
+                    Text lines[3];
+                    GHTTP_METRIC(_rm = &conn._m;)
+                    if (conn._headers.startLine().split(lines, 3, ' ') != 3) {
+                        GHTTP_METRIC(_metrics.parseErrors++;)
+                        return _reject(client, 400);
+                    }
+                    _conn = &conn;
+                    _handle(client, lines[0], lines[1], lines[2], conn._headers);
+                    _conn = nullptr;
+                }
+                if (conn.events() || conn.webSocket()) {
+                    GHTTP_METRIC(_metricsEnd();)
+                    conn._tmr = millis();
+                    if (conn.webSocket() && _ws_cb) _ws_cb(conn._ws, nullptr, 0);  // Open
+                    return true;
+                }
+                if (!conn._writer.left()) {
+                    GHTTP_METRIC(_metricsEnd();)
+                    return _nextRequest(conn);
+                }
+                GHTTP_METRIC(_rm = nullptr;)
+                conn._state = Connection::State::Response;
+                conn._tmr = millis();
+                // fall through
 
-        if (headers.contentType.startsWith(F("multipart")) && headers.length) {
-            bool eol = false;
-            size_t boundlen = 0;
-            while (client.connected()) {
-                GHTTP_ESP_YIELD();
-                String s = client.readStringUntil('\n');
-                if (!s.length() || s[s.length() - 1] != '\r') break;
-
-                if (!boundlen) boundlen = s.length();
-                headers.length -= s.length() + 1;  // + \n
-                if (s.length() == 1) {
-                    eol = 1;
-                    break;
+            case Connection::State::Response: {
+#if GHTTP_ADAPTIVE_BLOCKS
+                size_t len = StreamWriter::segmentBlock(_writable(client), conn._writer.left());  // целые сегменты, без ожидания места
+#else
+                size_t len = min(_writable(client), (size_t)HS_BLOCK_SIZE);
+#endif
+                if (len) {
+                    PoolBlock block(len);  // нет свободного блока - попытка в следующем tick
+                    size_t sent = block ? conn._writer.printNext(client, block.buf(), block.size()) : 0;
+                    if (sent) conn._tmr = millis();
+                    GHTTP_METRIC(conn._m.bytesOut += sent;)
                 }
-            }
-            if (eol && headers.length >= boundlen + 2 + 3) {
-                _req_cb(Request(lines[0], lines[1], &client, headers.length - (boundlen + 2 + 3)));  // \r\n + --
-            }
-            _flush();
-        } else {
-            _req_cb(Request(lines[0], lines[1], &client, headers.length, headers.chunked));
+                if (!conn._writer.left()) {
+                    GHTTP_METRIC(_rm = &conn._m; _metricsEnd();)
+                    return _nextRequest(conn);
+                }
+            } break;
+
+            case Connection::State::Drain:
+                // перед закрытием подключения пропускается только уже пришедшая часть тела
+                if (!_drainBody(client, conn) && conn._keep) break;
+                conn._drain = 0;
+                return _nextRequest(conn);
+
+            case Connection::State::Events:
+                if (_tickEvents(client, conn)) return true;
+                _evClients--;
+                return false;
+
+            case Connection::State::WebSocket:
+                if (_tickWebSocket(client, conn)) return true;
+                _endWebSocket(conn._ws);
+                return false;
         }
 
-        if (!_respStarted) send(500);
-        _clientp = nullptr;
+        if (!client.connected()) return false;
+        if (millis() - conn._tmr < (conn.idle() ? HS_KEEPALIVE_TOUT : HS_CLIENT_TOUT)) return true;
+        GHTTP_METRIC(if (conn._state != Connection::State::Line || !conn._headers.empty()) _metrics.timeouts++;)
+        return false;
     }
 
+   protected:
+#ifdef GHTTP_METRICS
+    Metrics _metrics;
+#endif
+
    private:
+#ifdef FS_H
+    struct Static {
+        Text uri;
+        Text path;
+        fs::FS* fs;
+        uint32_t maxAge;
+        Static* next;
+    };
+    Static* _static = nullptr;
+#endif
+
     RequestCallback _req_cb = nullptr;
+    Router<RequestCallback> _router;
+#ifdef GHTTP_METRICS
+    MetricsCallback _metrics_cb = nullptr;
+    RequestMetrics* _rm = nullptr;
+    Text _metricsPath;
+#endif
     ::Client* _clientp = nullptr;
+    Connection* _conn = nullptr;
     bool _respStarted = false;
     bool _contentBegin = false;
     bool _cors = true;
+    bool _keepAliveUse = true;
+    bool _keepAlive = false;
+    bool _http10 = false;
+    bool _chunkedUse = true;
+    bool _gzipUse = false;
+    bool _gzipAccept = false;
+    GzipWriter* _gz = nullptr;
+    EventQueue* _events = nullptr;
+    EventQueue::Drop _evDrop = EventQueue::Drop::Skip;
+    uint8_t _evClients = 0;
+    WebSocket::Callback _ws_cb = nullptr;
+    EventQueue* _wsQueue = nullptr;
+    WebSocket* _wsList = nullptr;
+    Text _wsKey;
+    Params _params;
+    uint16_t _wsId = 0;
+    uint16_t _wsVersion = 0;
+    uint8_t _wsClients = 0;
+    Text _range;
+    uint16_t _rangeCode = 0;
+    size_t _rangeFrom = 0;
+    size_t _rangeLen = 0;
+    StreamReader _body;
+    bool _bodyPart = false;
+    Headers _resp;
+    OutputBuffer _out;
+#if HS_OUT_SIZE
+    uint8_t _outBuf[HS_OUT_SIZE];
+#endif
 
-    void _beginResponse(Headers& resp, bool lastHeader) {
-        if (!_clientp || _respStarted) return;
+    void _handle(::Client& client, const Text& method, const Text& url, const Text& version, HeadersParser& headers) {
+        _clientp = &client;
+        _respStarted = false;
+        _contentBegin = false;
+        _resp = Headers();
+        _beginOut(client);
+        _http10 = (version == F("HTTP/1.0"));
+        _gzipAccept = headers.acceptGzip;
+        _keepAlive = _keepAliveUse && _conn && _conn->_count + 1 < HS_KEEPALIVE_MAX && !headers.close && (!_http10 || headers.keepAlive);
+        _body = StreamReader();
+        _bodyPart = false;
+        _range = (method == F("GET")) ? headers.range : Text();
+        _wsKey = (headers.websocket && headers.upgrade && method == F("GET")) ? headers.wsKey : Text();
+        _wsVersion = headers.wsVersion;
+        _rangeCode = 0;
 
-        _flush();
-        resp.cors(_cors);
-        if (lastHeader) _clientp->println(resp.s);
-        else _clientp->print(resp.s);
-        _contentBegin = lastHeader;
+        GHTTP_METRIC(if (_rm) { _rm->method = method; _rm->url = url; })
+
+        if (!headers) {
+            GHTTP_METRIC(_metrics.parseErrors++;)
+            _keepAlive = false;
+            send(_parseError(headers));
+            return _endRequest();
+        }
+
+        _body = StreamReader(&client, headers.length, headers.chunked);
+        GHTTP_METRIC(if (_rm) { _rm->handlerStart = micros(); _rm->_heapCheck(); })
+        _dispatch(method, url, headers);
+        GHTTP_METRIC(if (_rm) { _rm->handlerEnd = micros(); _rm->_heapCheck(); })
+
+        if (!_respStarted) send(500);
+        _endRequest();
+    }
+
+    // ограничить тело multipart запроса первой частью: граница и хэдеры части пропускаются,
+    // от конца тела отбрасывается закрывающая граница "\r\n--boundary--\r\n". Выполняется один раз за запрос
+    StreamReader& _firstPart() {
+        if (_bodyPart || _body.isChunked()) return _body;
+        _bodyPart = true;
+        _keepAlive = false;  // закрывающая граница остаётся в потоке
+
+        size_t bound = 0;
+        bool eol = false;
+        while (_body.available()) {
+            String s = _body.readStringUntil('\n');
+            if (!s.length() || s[s.length() - 1] != '\r') break;
+            if (!bound) bound = s.length();  // "--boundary\r"
+            if (s.length() == 1) {
+                eol = true;
+                break;
+            }
+        }
+        size_t left = _body.length();
+        bool ok = eol && left >= bound + 5;
+        GHTTP_METRIC(size_t received = _body.received;)
+        _body = StreamReader(ok ? _body.stream : nullptr, ok ? left - (bound + 5) : 0);
+        GHTTP_METRIC(_body.received = received;)
+        return _body;
+    }
+
+    void _dispatch(const Text& method, const Text& url, HeadersParser& headers) {
+        int16_t q = url.indexOf('?');
+        Text path = (q >= 0) ? Text(url.str(), q, url.pgm()) : url;
+        GHTTP_METRIC(if (_metricsPath.length() && method == F("GET") && path == _metricsPath) return _sendMetrics();)
+        const Router<RequestCallback>::Route* route = _router.match(method, path);
+        _params.begin((q >= 0) ? url.substring(q + 1) : Text());
+        if (route) route->cb(Request(method, url, _body, route->path, headers.contentType, &_params, this));
+#ifdef FS_H
+        else if (_serveStatic(method, path, headers)) return;
+#endif
+        else if (_req_cb) _req_cb(Request(method, url, _body, Text(), headers.contentType, &_params, this));
+        else send(404);
+    }
+
+#ifdef FS_H
+    // найти и отправить статичный файл. Вернёт false, если файл не найден
+    bool _serveStatic(const Text& method, const Text& path, HeadersParser& headers) {
+        bool head = (method == F("HEAD"));
+        if (!_static || !(head || method == F("GET"))) return false;
+        if (path.indexOf(Text("..")) >= 0) return false;
+
+        for (Static* st = _static; st; st = st->next) {
+            uint16_t ulen = st->uri.length();
+            if (ulen && st->uri[ulen - 1] == '/') ulen--;
+            if (!path.startsWith(Text(st->uri.str(), ulen, st->uri.pgm()))) continue;
+            if (path.length() > ulen && path[ulen] != '/') continue;
+
+            String fpath;
+            if (!st->path.length() || st->path[0] != '/') fpath += '/';
+            st->path.addString(fpath);
+            if (fpath[fpath.length() - 1] == '/') fpath.remove(fpath.length() - 1);
+            Text(path.str() + ulen, path.length() - ulen, path.pgm()).addString(fpath);
+            if (path.length() == ulen || path[path.length() - 1] == '/') {
+                if (!fpath.length() || fpath[fpath.length() - 1] != '/') fpath += '/';
+                fpath += F("index.html");  // папка
+            }
+
+            String gzpath = fpath + F(".gz");
+            bool hasGzip = st->fs->exists(gzpath);
+            bool gzip = hasGzip && headers.acceptGzip;
+            if (!gzip && !st->fs->exists(fpath)) continue;
+
+            File file = st->fs->open(gzip ? gzpath : fpath, "r");
+            if (!file || file.isDirectory()) continue;
+
+            // ETag по размеру и времени изменения файла - содержимое не читается
+            char etag[32];
+            snprintf(etag, sizeof(etag), "\"%lx-%lx%s\"", (unsigned long)file.size(), (unsigned long)file.getLastWrite(), gzip ? "-gz" : "");
+
+            bool match = _etagMatch(headers.ifNoneMatch, Text(etag));
+            _flush();
+            _start(match ? 304 : _parseRange(file.size()));
+            _resp.add(F("ETag"), etag);
+            _resp.cache(st->maxAge);
+            if (hasGzip) _resp.print(F("Vary: Accept-Encoding\r\n"));
+
+            if (match) {
+                _resp._length = true;  // ответ без тела
+                send(304);
+            } else if (head) {
+                _resp.print(F("Accept-Ranges: bytes\r\n"));
+                _resp.length(file.size());
+                _resp.type(getMime(fpath));
+                _resp.gzip(gzip);
+                _endHeaders(true);
+                _flushHeaders();
+                _clientp = nullptr;
+            } else {
+                sendFile(file, getMime(fpath), false, gzip);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    // If-None-Match содержит ETag или *
+    static bool _etagMatch(const Text& list, const Text& etag) {
+        int16_t from = 0;
+        while (from < (int16_t)list.length()) {
+            int16_t to = list.indexOf(',', from);
+            if (to < 0) to = list.length();
+            Text tag = Text(list.str() + from, to - from, list.pgm()).trim();
+            if (tag.length() > 2 && tag[0] == 'W' && tag[1] == '/') tag = Text(tag.str() + 2, tag.length() - 2, tag.pgm());
+            if (tag == etag || (tag.length() == 1 && tag[0] == '*')) return true;
+            from = to + 1;
+        }
+        return false;
+    }
+#endif
+
+    void _endRequest() {
+        if (_clientp) {
+            if (_resp._started && !_contentBegin) _endHeaders(false);
+            _flushHeaders();
+        }
+        if (_gz) _gz->end();
+        _out.end();
+        if (_conn) {
+            // хвост chunked тела без разбора не найти - подключение закрывается
+            bool chunked = _body.isChunked() && _body.available();
+            if (chunked) _keepAlive = false;
+            _conn->_drain = chunked ? (size_t)-1 : _body.length();
+            _conn->_keep = _keepAlive;
+        } else if (_keepAlive) {
+            _body.skip();
+        }
+        GHTTP_METRIC(_metricsResponse();)
+        _clientp = nullptr;
+    }
+
+    // отправить подписчику события из очереди. Вернёт false, если подключение нужно закрыть
+    bool _tickEvents(::Client& client, Connection& conn) {
+        while (client.available()) client.read();  // от подписчика данные не ожидаются
+        if (!client.connected() || !_sendQueue(client, conn, *_events)) return false;
+
+        if (conn._evPos == _events->end() && millis() - conn._tmr >= HS_EVENTS_PING && _writableQueue(client) >= 3) {
+            client.print(F(":\n\n"));
+            conn._tmr = millis();
+        }
+        return true;
+    }
+
+    // принять кадры WebSocket, отправить кадры из очереди. Вернёт false, если подключение нужно закрыть
+    bool _tickWebSocket(::Client& client, Connection& conn) {
+        WebSocket& ws = conn._ws;
+        if (!ws._read(_ws_cb) || !client.connected()) return false;
+        if (ws._closing) return millis() - ws._rx < HS_CLIENT_TOUT;  // ожидание close от клиента
+
+        // сообщение send() отправляется целиком до кадров из очереди
+        if (ws._sendNext()) {
+            if (!_sendQueue(client, conn, *_wsQueue)) return false;
+            ws._partial = conn._evPartial;
+        }
+        ws._sendPong();  // pong на ping, пришедший во время отправки кадра
+        if (conn._evPos == _wsQueue->end() && millis() - conn._tmr >= HS_WS_PING && ws._frame(WebSocket::OpPing, nullptr, 0)) {
+            conn._tmr = millis();
+        }
+        return millis() - ws._rx < HS_WS_PING * 2;
+    }
+
+    // WebSocket подключение закрыто
+    void _endWebSocket(WebSocket& ws) {
+        WebSocket** p = &_wsList;
+        while (*p && *p != &ws) p = &(*p)->_next;
+        if (*p) *p = ws._next;
+        _wsClients--;
+        ws._event = WebSocket::Event::Close;
+        ws._closing = true;
+        if (_ws_cb) _ws_cb(ws, nullptr, 0);
+    }
+
+    // вывести в подключение данные из очереди с его позиции. Вернёт false, если подключение нужно закрыть
+    bool _sendQueue(::Client& client, Connection& conn, EventQueue& queue) {
+        if (queue.lost(conn._evPos)) {
+            // сообщение, отправленное не полностью, пропустить нельзя - поток будет испорчен
+            if (_evDrop == EventQueue::Drop::Close || conn._evPartial) return false;
+            conn._evPos = queue.first();
+        }
+        if (conn._evPos == queue.end()) return true;
+
+        // при заполненном буфере отправки сообщения выводятся целиком, чтобы отставшее подключение остановилось на границе сообщения
+        size_t len = _writableQueue(client);
+        if (len && queue.printTo(client, conn._evPos, len, len >= GHTTP_TCP_MSS)) {
+            conn._tmr = millis();
+            conn._evPartial = queue.partial(conn._evPos);
+        }
+        return millis() - conn._tmr < HS_EVENTS_PING;  // подключение не принимает данные
+    }
+
+    // свободное место в буфере отправки для очереди. На ESP при заполненном буфере 0 - данные ждут в очереди
+    size_t _writableQueue(::Client& client) {
+        int len = client.availableForWrite();
+#if defined(ESP8266) || defined(ESP32)
+        return len > 0 ? len : 0;
+#else
+        return len > 0 ? len : HS_BLOCK_SIZE;
+#endif
+    }
+
+    // перейти к следующему запросу в keep-alive подключении. Непрочитанное тело сначала пропускается в состоянии Drain
+    bool _nextRequest(Connection& conn) {
+        if (conn._drain) {
+            conn._state = Connection::State::Drain;
+            conn._tmr = millis();
+            return true;
+        }
+        if (!conn._keep) return false;
+        uint16_t count = conn._count + 1;
+        conn.begin();
+        conn._count = count;
+        GHTTP_METRIC(conn._m.accept = 0;)  // начало следующего запроса - первый байт
+        return true;
+    }
+
+    // пропустить доступную часть непрочитанного тела без ожидания. Вернёт true, когда тело пропущено целиком
+    bool _drainBody(::Client& client, Connection& conn) {
+        PoolBlock block(HS_FLUSH_BLOCK);
+        while (conn._drain && client.available() > 0) {
+            size_t len = min((size_t)client.available(), conn._drain);
+            int read = block ? client.read(block.buf(), min(len, block.size())) : (client.read() >= 0);
+            if (read <= 0) break;
+            conn._drain -= read;
+            conn._tmr = millis();
+        }
+        return !conn._drain;
+    }
+
+    // код ответа на ошибку разбора: не поместилась строка запроса или строка хэдера
+    static uint16_t _parseError(const HeadersParser& headers) {
+        if (!headers.overflow) return 400;
+        return headers.startLine().length() ? 431 : 414;
+    }
+
+    bool _reject(::Client& client, uint16_t code) {
+        _clientp = &client;
+        _respStarted = _contentBegin = false;
+        _resp = Headers();
+        _beginOut(client);
+        _keepAlive = false;
+        _gzipAccept = false;
+        _body = StreamReader();
+        send(code);
+        _out.end();
+        GHTTP_METRIC(_metricsResponse(); _metricsEnd();)
+        _clientp = nullptr;
+        return false;
+    }
+
+    void _beginOut(::Client& client) {
+#if HS_OUT_SIZE
+        _out.begin(&client, _outBuf, HS_OUT_SIZE);
+#else
+        _out.begin(&client, nullptr, 0);
+#endif
+    }
+
+    // свободное место в буфере отправки клиента
+    size_t _writable(::Client& client) {
+#ifdef ESP8266
+        return client.availableForWrite();
+#else
+        int len = client.availableForWrite();
+        return len > 0 ? len : (GHTTP_ADAPTIVE_BLOCKS ? GHTTP_BLOCK_MAX : HS_BLOCK_SIZE);
+#endif
+    }
+
+    // начать ответ в буфере хэдеров
+    void _start(uint16_t code) {
+        if (_respStarted) return;
+        if (!_resp._started) _resp.begin(code);
+        _resp.cors(_cors);
         _respStarted = true;
     }
-    void _sendFile(StreamWriter& writer, const Text& type, bool cache, bool gzip) {
+
+    // завершить блок хэдеров. Ответ без длины в keep-alive подключении отправляется в формате chunked,
+    // иначе завершается закрытием подключения
+    void _endHeaders(bool length) {
+        bool chunked = !length && _keepAlive && _chunkedUse && !_http10;
+        bool gzip = !length && _gzipUse && _gzipAccept && (_gz || (_gz = new GzipWriter()));
+        if (!length && !chunked) _keepAlive = false;
+        if (gzip) _resp.print(F("Content-Encoding: gzip\r\nVary: Accept-Encoding\r\n"));
+        if (chunked) _resp.print(F("Transfer-Encoding: chunked\r\n"));
+        if (!_keepAlive) _resp.print(F("Connection: close\r\n"));
+        else if (_http10) _resp.print(F("Connection: keep-alive\r\n"));
+        _resp.print(F("\r\n"));
+        _contentBegin = true;
+        if (chunked) {
+            _flushHeaders();
+            _out.setChunked(true);
+        }
+        if (gzip) {
+            _flushHeaders();
+            _gz->begin(&_out);
+        }
+    }
+
+    // вывод данных ответа: через сжатие или сразу в буфер вывода
+    Print& _output() {
+        if (_gz && _gz->active()) return *_gz;
+        return _out;
+    }
+
+    // переместить накопленные хэдеры в буфер вывода
+    void _flushHeaders() {
+        _resp.flushTo(_out);
+    }
+    void _sendFile(StreamWriter& writer, const Text& type, bool cache, bool gzip, bool defer = false) {
         _flush();
         writer.setBlockSize(HS_BLOCK_SIZE);
 
         if (!_contentBegin) {
-            Headers resp;
-            if (!_respStarted) {
-                resp.begin(200);
-                resp.cors(_cors);
+            size_t size = writer.length();
+            if (!_respStarted) _start(_parseRange(size));
+            if (_rangeCode == 206 && !writer.setRange(_rangeFrom, _rangeLen)) _rangeCode = 416;
+
+            if (_rangeCode == 416) {
+                _resp.print(F("Content-Range: bytes */"));
+                _resp.print(size);
+                _resp.clrf();
+                _resp.length(0);
+                _endHeaders(true);
+                _flushHeaders();
+                _clientp = nullptr;
+                return;
+            }
+            if (_rangeCode == 206) {
+                _resp.print(F("Content-Range: bytes "));
+                _resp.print(_rangeFrom);
+                _resp.print('-');
+                _resp.print(_rangeFrom + _rangeLen - 1);
+                _resp.print('/');
+                _resp.print(size);
+                _resp.clrf();
             }
-            resp.length(writer.length());
-            resp.type(type);
-            resp.cache(cache);
-            resp.gzip(gzip);
-            _clientp->println(resp.s);
+            _resp.print(F("Accept-Ranges: bytes\r\n"));
+            _resp.length(writer.left());
+            _resp.type(type);
+            _resp.cache(cache);
+            _resp.gzip(gzip);
+            _endHeaders(true);
 
-            _clientp->print(writer);
+            // начало файла уходит в одном пакете с хэдерами
+            _flushHeaders();
+            _out.fill(writer);
+
+            // асинхронная отправка из Server::tick, если данные доступны после выхода из обработчика
+            if (defer && _conn) {
+                _conn->_writer = writer;
+            } else {
+                _out.flush();
+                size_t sent = _clientp->print(writer);
+                GHTTP_METRIC(if (_rm) _rm->bytesOut += sent;)
+                (void)sent;
+            }
+        } else if (_out.chunked()) {
+            writer.printTo(_output());  // продолжение ответа без длины
         }
-        _respStarted = true;
         _clientp = nullptr;
     }
+    // разобрать Range запроса для данных размера size. Вернёт код ответа: 200 - данные целиком, 206 - диапазон, 416 - диапазон вне данных.
+    // Запрос нескольких диапазонов выполняется отправкой данных целиком
+    uint16_t _parseRange(size_t size) {
+        _rangeCode = 200;
+        if (!_range.startsWith(F("bytes=")) || _range.indexOf(',') >= 0) return _rangeCode;
+
+        Text r(_range.str() + 6, _range.length() - 6, _range.pgm());
+        int16_t dash = r.indexOf('-');
+        if (dash < 0) return _rangeCode;
+        Text from(r.str(), dash, r.pgm());
+        Text to(r.str() + dash + 1, r.length() - dash - 1, r.pgm());
+
+        if (from.length()) {
+            _rangeFrom = from.toInt32();
+            size_t last = to.length() ? (size_t)to.toInt32() : size - 1;
+            if (_rangeFrom >= size) return _rangeCode = 416;
+            if (last < _rangeFrom) return _rangeCode;
+            _rangeLen = min(last, size - 1) - _rangeFrom + 1;
+        } else {  // последние n байт
+            size_t n = to.toInt32();
+            if (!n || !size) return _rangeCode = 416;
+            _rangeLen = min(n, size);
+            _rangeFrom = size - _rangeLen;
+        }
+        return _rangeCode = 206;
+    }
+
+    // пропустить непрочитанное тело запроса. В асинхронном режиме тело пропускается после ответа, в состоянии Drain
     void _flush() {
-        uint8_t bytes[HS_FLUSH_BLOCK];
-        while (_clientp && _clientp->connected() && _clientp->available()) {
+        if (!_clientp || _conn) return;
+        if (_keepAlive) {
+            _body.skip();
+            return;
+        }
+        PoolBlock block(HS_FLUSH_BLOCK);
+        while (_clientp->connected() && _clientp->available()) {
             delay(1);
             GHTTP_ESP_YIELD();
-            _clientp->readBytes(bytes, min(_clientp->available(), HS_FLUSH_BLOCK));
+            if (block) _clientp->readBytes(block.buf(), min((size_t)_clientp->available(), block.size()));
+            else _clientp->read();
         }
     }
+    // данные копятся в буфере вывода вместе с хэдерами и уходят при заполнении или в конце ответа
     void _send(const uint8_t* data, size_t len) {
-        StreamWriter writer(data, len);
-        _clientp->print(writer);
+        _flushHeaders();
+        _output().write(data, len);
+    }
+
+#ifdef GHTTP_METRICS
+    // хэдеры запроса разобраны
+    void _metricsHeaders(RequestMetrics& m, HeadersParser& headers) {
+        m.headers = micros();
+        m.bytesIn += headers.received;
+        m._heapCheck();
+    }
+
+    // ответ сформирован: код, принятое тело и отправленное через буфер вывода
+    void _metricsResponse() {
+        if (!_rm) return;
+        _rm->code = _resp._code;
+        _rm->bytesIn += _body.received;
+        _rm->bytesOut += _out.sent;
+    }
+
+    // последний байт ответа отправлен
+    void _metricsEnd() {
+        if (!_rm) return;
+        RequestMetrics& m = *_rm;
+        _rm = nullptr;
+        m.sent = micros();
+        m._heapCheck();
+        _metrics.count(m);
+        if (_metrics_cb) _metrics_cb(m);
     }
+
+    // ответ со счётчиками сервера и пула блоков
+    void _sendMetrics() {
+        _flush();
+        _start(200);
+        _resp.type(F("text/plain; version=0.0.4"));
+        _resp.cache(false);
+        _endHeaders(false);
+        _flushHeaders();
+
+        Print& out = _output();
+        _metrics.printTo(out, F("ghttp_server"), true);
+        const BlockPool::Stats& pool = BlockPool::stats();
+        out.print(F("# TYPE ghttp_pool_taken_total counter\nghttp_pool_taken_total "));
+        out.print(pool.taken);
+        out.print(F("\n# TYPE ghttp_pool_fallback_total counter\nghttp_pool_fallback_total "));
+        out.print(pool.fallback);
+        out.print(F("\n# TYPE ghttp_pool_failed_total counter\nghttp_pool_failed_total "));
+        out.print(pool.failed);
+        out.print(F("\n# TYPE ghttp_pool_peak gauge\nghttp_pool_peak "));
+        out.print(pool.peak);
+        out.print('\n');
+        _clientp = nullptr;
+    }
+#endif
 };
 
 }  // namespace ghttp
@@ -0,0 +1,396 @@
+#pragma once
+#include <Arduino.h>
+#include <Client.h>
+#include <StringUtils.h>
+
+#ifndef __AVR__
+#include <functional>
+#endif
+
+#include "BlockPool.h"
+#include "cfg.h"
+
+#ifndef HS_WS_PING
+#define HS_WS_PING 15000        // период ping неактивному WebSocket подключению. Без входящих данных дольше двух периодов подключение закрывается
+#endif
+
+#ifndef HS_WS_BLOCK
+#ifdef __AVR__
+#define HS_WS_BLOCK 64          // блок чтения данных WebSocket - макс. порция данных в обработчике
+#else
+#define HS_WS_BLOCK 1024        // блок чтения данных WebSocket - макс. порция данных в обработчике
+#endif
+#endif
+
+#define HS_WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+namespace ghttp {
+
+class ServerBase;
+
+// WebSocket подключение сервера (RFC 6455): разбор кадров клиента, ответ на ping и close, отправка кадров
+class WebSocket {
+    friend class ServerBase;
+
+   public:
+    // событие обработчика
+    enum class Event : uint8_t {
+        Open,     // подключение открыто
+        Message,  // порция данных сообщения
+        Close,    // подключение закрыто
+    };
+
+#ifdef __AVR__
+    typedef void (*Callback)(WebSocket& ws, uint8_t* data, size_t len);
+#else
+    typedef std::function<void(WebSocket& ws, uint8_t* data, size_t len)> Callback;
+#endif
+
+    // номер подключения, уникальный за время работы сервера
+    uint16_t id() const {
+        return _id;
+    }
+
+    // событие
+    Event event() const {
+        return _event;
+    }
+
+    // сообщение бинарное, иначе текст
+    bool binary() const {
+        return _binary;
+    }
+
+    // смещение текущей порции данных от начала сообщения
+    size_t index() const {
+        return _index;
+    }
+
+    // последняя порция сообщения
+    bool final() const {
+        return _fin && !_left;
+    }
+
+    // отправить сообщение этому подключению. Сообщение, не помещающееся в буфер отправки, досылается в Server::tick
+    // прямо из data - данные должны существовать, пока sending() == true. Вернёт false, если подключение закрыто,
+    // предыдущее сообщение ещё отправляется или в буфере отправки нет места даже под заголовок
+    bool send(const uint8_t* data, size_t len, bool binary = false) {
+        if (_closing || _partial || _txLeft || !_client) return false;
+#if defined(ESP8266) || defined(ESP32)
+        uint8_t head[10];
+        uint8_t hlen = header(head, binary ? OpBinary : OpText, len);
+        int avail = _client->availableForWrite();
+        if (avail >= 0 && (size_t)avail < hlen + len) {
+            if ((size_t)avail < hlen || _client->write(head, hlen) != hlen) return false;
+            size_t sent = _client->write(data, avail - hlen);
+            _tx = data + sent;
+            _txLeft = len - sent;
+            _partial = true;
+            return true;
+        }
+#endif
+        return _frame(binary ? OpBinary : OpText, data, len);
+    }
+
+    // отправить текст этому подключению
+    bool send(const su::Text& text) {
+        return send((const uint8_t*)text.str(), text.length());
+    }
+
+    // сообщение send() отправлено не полностью
+    bool sending() const {
+        return _txLeft;
+    }
+
+    // закрыть подключение с кодом code
+    void close(uint16_t code = 1000) {
+        if (_closing) return;
+        uint8_t data[2] = {uint8_t(code >> 8), uint8_t(code)};
+        _frame(OpClose, data, 2);
+        _closing = true;
+        _rx = millis();
+    }
+
+    // заголовок кадра сервера (без маски) для данных длины len. head - не меньше 10 байт, вернёт длину заголовка
+    static uint8_t header(uint8_t* head, uint8_t opcode, size_t len) {
+        head[0] = 0x80 | opcode;
+        if (len < 126) {
+            head[1] = len;
+            return 2;
+        }
+        if (len <= 0xffff) {
+            head[1] = 126;
+            head[2] = len >> 8;
+            head[3] = len;
+            return 4;
+        }
+        head[1] = 127;
+        for (uint8_t i = 0; i < 8; i++) head[9 - i] = (i < sizeof(size_t)) ? uint8_t((uint64_t)len >> (i * 8)) : 0;
+        return 10;
+    }
+
+    // значение Sec-WebSocket-Accept для ключа клиента: base64(sha1(key + GUID)), 28 символов и 0
+    static void accept(const su::Text& key, char* out) {
+        uint8_t buf[64 + 64];
+        uint8_t len = min(key.length(), (uint16_t)24);
+        for (uint8_t i = 0; i < len; i++) buf[i] = key[i];
+        memcpy_P(buf + len, PSTR(HS_WS_GUID), 36);
+        uint8_t hash[20];
+        _sha1(buf, len + 36, hash);
+        _base64(hash, 20, out);
+    }
+
+   private:
+    enum Opcode : uint8_t {
+        OpContinuation = 0,
+        OpText = 1,
+        OpBinary = 2,
+        OpClose = 8,
+        OpPing = 9,
+        OpPong = 10,
+    };
+
+    WebSocket* _next = nullptr;
+    ::Client* _client = nullptr;
+    uint16_t _id = 0;
+    Event _event = Event::Open;
+    uint8_t _head[14];
+    uint8_t _hlen = 0;
+    uint8_t _need = 2;
+    uint8_t _mask[4];
+    uint8_t _opcode = 0;
+    size_t _left = 0;       // осталось данных кадра
+    size_t _pos = 0;        // позиция в данных кадра для маски
+    size_t _index = 0;
+    bool _fin = false;
+    bool _binary = false;
+    bool _fragmented = false;   // ожидается продолжение сообщения
+    bool _closing = false;
+    bool _partial = false;      // в клиента выведен не весь кадр (из очереди сервера или send())
+    uint32_t _rx = 0;           // последние входящие данные
+    const uint8_t* _tx = nullptr;   // данные send(), ожидающие отправки
+    size_t _txLeft = 0;
+    uint8_t _pong[125];         // данные последнего ping, pong на который ещё не отправлен
+    uint8_t _pongLen = 0;
+    bool _pongWait = false;
+
+    void _begin(::Client& client, uint16_t id) {
+        *this = WebSocket();
+        _client = &client;
+        _id = id;
+        _rx = millis();
+    }
+
+    // принять доступные кадры. Вернёт false, если подключение нужно закрыть
+    bool _read(Callback& cb) {
+        while (_client->available()) {
+            _rx = millis();
+            if (_hlen < _need) {
+                _head[_hlen++] = _client->read();
+                if (_hlen == 2 && !_parseStart()) return false;
+                if (_hlen == _need) {
+                    _parseLength();
+                    if (_left) continue;
+                    if (_opcode >= OpClose) {
+                        if (!_control(nullptr, 0)) return false;
+                        _reset();
+                    } else {
+                        _data(cb, nullptr, 0);
+                    }
+                }
+                continue;
+            }
+
+            if (_opcode >= OpClose) {
+                // управляющий кадр обрабатывается целиком, pong ждёт конца кадра в выводе
+                if ((size_t)_client->available() < _left) break;
+                uint8_t buf[125];
+                _client->read(buf, _left);
+                _unmask(buf, _left);
+                if (!_control(buf, _left)) return false;
+                _reset();
+                continue;
+            }
+
+            PoolBlock block(min(_left, (size_t)HS_WS_BLOCK));
+            if (!block) break;
+            int len = _client->read(block.buf(), min((size_t)_client->available(), block.size()));
+            if (len <= 0) break;
+            _unmask(block.buf(), len);
+            _left -= len;
+            _data(cb, block.buf(), len);
+            _index += len;
+        }
+        return true;
+    }
+
+    // первые 2 байта заголовка: флаги, код, маска и длина
+    bool _parseStart() {
+        _fin = _head[0] & 0x80;
+        _opcode = _head[0] & 0x0f;
+        uint8_t len = _head[1] & 0x7f;
+        bool masked = _head[1] & 0x80;
+        if ((_head[0] & 0x70) || !masked) return _fail(1002);  // расширения не используются, клиент обязан маскировать
+        if (_opcode >= OpClose) {
+            if (!_fin || len > 125 || (_opcode != OpClose && _opcode != OpPing && _opcode != OpPong)) return _fail(1002);
+        } else if (_opcode > OpBinary) {
+            return _fail(1002);
+        } else if ((_opcode == OpContinuation) != _fragmented) {
+            return _fail(1002);  // продолжение без начала или новое сообщение до конца предыдущего
+        }
+        _need = 2 + (len == 126 ? 2 : (len == 127 ? 8 : 0)) + 4;
+        return true;
+    }
+
+    void _parseLength() {
+        uint8_t len = _head[1] & 0x7f;
+        uint8_t ext = (len == 126) ? 2 : (len == 127 ? 8 : 0);
+        if (ext) {
+            uint64_t l = 0;
+            for (uint8_t i = 0; i < ext; i++) l = (l << 8) | _head[2 + i];
+            _left = (l > (size_t)-1) ? (size_t)-1 : l;
+        } else {
+            _left = len;
+        }
+        memcpy(_mask, _head + _need - 4, 4);
+        _pos = 0;
+        if (_opcode == OpText || _opcode == OpBinary) {
+            _binary = (_opcode == OpBinary);
+            _index = 0;
+        }
+    }
+
+    // порция данных сообщения в обработчик. После close() данные не передаются
+    void _data(Callback& cb, uint8_t* data, size_t len) {
+        _fragmented = !_fin;
+        _event = Event::Message;
+        if (cb && !_closing) cb(*this, data, len);
+        if (!_left) _reset();
+    }
+
+    bool _control(uint8_t* data, uint8_t len) {
+        switch (_opcode) {
+            case OpPing:
+                // ответ только на последний ping (RFC 6455 5.5.3)
+                if (len) memcpy(_pong, data, len);
+                _pongLen = len;
+                _pongWait = true;
+                _sendPong();
+                break;
+
+            case OpClose:
+                if (!_closing) _frame(OpClose, data, len >= 2 ? 2 : 0);
+                return false;
+
+            default:
+                break;
+        }
+        return true;
+    }
+
+    void _reset() {
+        _hlen = 0;
+        _need = 2;
+    }
+
+    void _unmask(uint8_t* data, size_t len) {
+        for (size_t i = 0; i < len; i++) data[i] ^= _mask[(_pos + i) & 3];
+        _pos += len;
+    }
+
+    // отправить кадр. Короткий кадр уходит одной записью
+    bool _frame(uint8_t opcode, const uint8_t* data, size_t len) {
+        if (!_client || _partial) return false;
+        uint8_t buf[10 + 128];
+        uint8_t hlen = header(buf, opcode, len);
+#if defined(ESP8266) || defined(ESP32)
+        int avail = _client->availableForWrite();
+        if (avail >= 0 && (size_t)avail < hlen + len) return false;
+#endif
+        if (len <= 128) {
+            if (len) memcpy(buf + hlen, data, len);
+            return _client->write(buf, hlen + len) == hlen + len;
+        }
+        return _client->write(buf, hlen) == hlen && _client->write(data, len) == len;
+    }
+
+    // отправить ожидающий pong, если кадр в выводе завершён и есть место
+    void _sendPong() {
+        if (_pongWait && !_partial && !_closing && _frame(OpPong, _pong, _pongLen)) _pongWait = false;
+    }
+
+    // дослать данные send() по мере освобождения буфера отправки. Вернёт true, если отправлять нечего
+    bool _sendNext() {
+        if (!_txLeft) return true;
+        int avail = _client->availableForWrite();
+        if (avail > 0) {
+            size_t sent = _client->write(_tx, min((size_t)avail, _txLeft));
+            _tx += sent;
+            _txLeft -= sent;
+        }
+        if (_txLeft) return false;
+        _partial = false;
+        return true;
+    }
+
+    bool _fail(uint16_t code) {
+        close(code);
+        return false;
+    }
+
+    static uint32_t _rol(uint32_t v, uint8_t n) {
+        return (v << n) | (v >> (32 - n));
+    }
+
+    // SHA-1 сообщения до 119 байт
+    static void _sha1(uint8_t* msg, uint8_t len, uint8_t* out) {
+        uint8_t blocks = (len + 8) / 64 + 1;
+        memset(msg + len, 0, blocks * 64 - len);
+        msg[len] = 0x80;
+        uint32_t bits = len * 8;
+        for (uint8_t i = 0; i < 4; i++) msg[blocks * 64 - 1 - i] = bits >> (i * 8);
+
+        uint32_t h[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+        for (uint8_t b = 0; b < blocks; b++) {
+            uint32_t w[16];
+            for (uint8_t i = 0; i < 16; i++) {
+                const uint8_t* p = msg + b * 64 + i * 4;
+                w[i] = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+            }
+            uint32_t a = h[0], bb = h[1], c = h[2], d = h[3], e = h[4];
+            for (uint8_t i = 0; i < 80; i++) {
+                if (i >= 16) w[i & 15] = _rol(w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15], 1);
+                uint32_t f, k;
+                if (i < 20) f = (bb & c) | (~bb & d), k = 0x5a827999;
+                else if (i < 40) f = bb ^ c ^ d, k = 0x6ed9eba1;
+                else if (i < 60) f = (bb & c) | (bb & d) | (c & d), k = 0x8f1bbcdc;
+                else f = bb ^ c ^ d, k = 0xca62c1d6;
+                uint32_t t = _rol(a, 5) + f + e + k + w[i & 15];
+                e = d;
+                d = c;
+                c = _rol(bb, 30);
+                bb = a;
+                a = t;
+            }
+            h[0] += a;
+            h[1] += bb;
+            h[2] += c;
+            h[3] += d;
+            h[4] += e;
+        }
+        for (uint8_t i = 0; i < 20; i++) out[i] = h[i / 4] >> (24 - (i & 3) * 8);
+    }
+
+    static void _base64(const uint8_t* data, uint8_t len, char* out) {
+        static const char t[] PROGMEM = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (uint8_t i = 0; i < len; i += 3) {
+            uint32_t v = (uint32_t)data[i] << 16;
+            if (i + 1 < len) v |= data[i + 1] << 8;
+            if (i + 2 < len) v |= data[i + 2];
+            for (uint8_t j = 0; j < 4; j++) *out++ = (i + j <= len) ? pgm_read_byte(t + ((v >> (18 - j * 6)) & 63)) : '=';
+        }
+        *out = 0;
+    }
+};
+
+}  // namespace ghttp
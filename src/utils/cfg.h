@@ -4,4 +4,34 @@
 #define GHTTP_ESP_YIELD() delay(0);//esp_yield();//optimistic_yield(2000);
 #else
 #define GHTTP_ESP_YIELD()
-#endif
\ No newline at end of file
+#endif
+
+#ifndef GHTTP_TCP_MSS
+#if defined(ESP32)
+#define GHTTP_TCP_MSS 1436          // размер TCP сегмента
+#elif defined(ESP8266)
+#define GHTTP_TCP_MSS 536           // размер TCP сегмента
+#else
+#define GHTTP_TCP_MSS 1460          // размер TCP сегмента
+#endif
+#endif
+
+#ifndef GHTTP_ADAPTIVE_BLOCKS
+#if defined(ESP8266) || defined(ESP32)
+#define GHTTP_ADAPTIVE_BLOCKS 1     // размер блоков передачи по свободному месту в буфере отправки и MSS
+#else
+#define GHTTP_ADAPTIVE_BLOCKS 0     // размер блоков передачи по свободному месту в буфере отправки и MSS
+#endif
+#endif
+
+#ifndef GHTTP_BLOCK_MAX
+#define GHTTP_BLOCK_MAX (GHTTP_TCP_MSS * 2)  // макс. размер блока в адаптивном режиме
+#endif
+
+// #define GHTTP_METRICS            // счётчики и замеры времени запросов сервера и клиента (Metrics.h)
+
+#ifdef GHTTP_METRICS
+#define GHTTP_METRIC(...) __VA_ARGS__
+#else
+#define GHTTP_METRIC(...)
+#endif